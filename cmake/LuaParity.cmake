@@ -0,0 +1,57 @@
+# Checks that two builds of battle-sim, one on Lua 5.3 and one on LuaJIT,
+# agree: both play the same seeded battles, and their statistics have to
+# match exactly. Run as a script, from the `lua-parity' test or by hand:
+#
+#     cmake -DSIM_A=build-lua/battle-sim -DSIM_B=build-luajit/battle-sim \
+#           -P cmake/LuaParity.cmake
+#
+# Each simulator is run from its own directory, so that it finds the copy
+# of `data/' next to it.
+
+if(NOT SIM_A OR NOT SIM_B)
+    message(FATAL_ERROR "usage: cmake -DSIM_A=<battle-sim> -DSIM_B=<battle-sim> -P LuaParity.cmake")
+endif()
+if(NOT SEED)
+    set(SEED 1234)
+endif()
+
+# one run per line; between them they use every skill in `data/'
+set(runs
+    "--battles 2000 --team-size 4"
+    "--battles 500 --team-size 8 --player-ai utility --enemy-ai utility"
+    "--battles 500 --team-size 8 --player mixed cleaver --enemy mixed warlord --player-ai utility"
+)
+
+# the statistics from a run, without the timings in front of them
+function(run_sim sim args out)
+    get_filename_component(dir "${sim}" DIRECTORY)
+    separate_arguments(args)
+    execute_process(
+        COMMAND "${sim}" --seed ${SEED} --threads 1 ${args}
+        WORKING_DIRECTORY "${dir}"
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE json
+        ERROR_VARIABLE errors
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${sim} ${args} failed (${result}):\n${errors}")
+    endif()
+    string(REGEX REPLACE "^.*\"stats\":" "" json "${json}")
+    set(${out} "${json}" PARENT_SCOPE)
+endfunction()
+
+set(failed FALSE)
+foreach(args IN LISTS runs)
+    run_sim("${SIM_A}" "${args}" a)
+    run_sim("${SIM_B}" "${args}" b)
+    if(a STREQUAL b)
+        message(STATUS "same: ${args}")
+    else()
+        message(STATUS "DIFFERENT: ${args}\n  ${SIM_A}:\n${a}\n  ${SIM_B}:\n${b}")
+        set(failed TRUE)
+    endif()
+endforeach()
+
+if(failed)
+    message(FATAL_ERROR "seeded runs differ between the two builds")
+endif()
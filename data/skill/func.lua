@@ -66,8 +66,7 @@ end
 -- returns a value suitable for use as a modifer
 --   i.e, 20% resistance results in a return value of 0.8
 function skill.resistance(s, entity)
-    -- TODO: correctly calculate secondary elements
-    local resist = entity.stats:resists(s.element)
+    local resist = entity:resists(s.element)
     return -resist / 100 + 1
 end
 
@@ -75,18 +74,28 @@ end
 -- generate a 'perform' function that is often correct;
 -- no support for any perks at the moment, but good for prototyping
 -- can use this as an (overcomplicated) base for new specialised skills
-function skill.default_perform(s, source, target)
-    -- get who we are actually attacking
-    -- is it just the direct target, or is this an AOE move?
-    local target_list = { target }
-    if s.spread == spread.aoe or s.spread == spread.semiaoe then
-        target_list = target:getTeam()
-    elseif s.spread == spread.field then
-        error('unimplemented!')
+function skill.default_perform(s, source, target, targets)
+    -- the engine works out who we are attacking from the spread for us;
+    -- if we have that, let the native code deal with every target in one go
+    if type(targets) == "userdata" then
+        skill.deal_damage(s, source, target, targets)
+        return
+    end
+
+    -- otherwise we've been called by hand, and need to work it out ourselves
+    if targets == nil then
+        targets = { target }
+        if s.spread == spread.aoe or s.spread == spread.semiaoe then
+            targets = target:getTeam()
+        elseif s.spread == spread.field then
+            error('default_perform: field skills need the resolved targets')
+        end
     end
 
     -- loop over every target and see what happens
-    for _, entity in ipairs(target_list) do
+    for i = 1, #targets do
+        local entity = targets[i]
+
         -- test if we actually hit them
         local result = skill.did_hit(s, source, entity)
         if result ~= 0 then
@@ -100,7 +109,7 @@ function skill.default_perform(s, source, target)
 
             -- if this is semiaoe and they weren't our original target,
             -- we do a 70% modifier
-            if s.spread == spread.semiaoe and entity == target then
+            if s.spread == spread.semiaoe and not entity:is(target) then
                 mod = mod * 0.7
             end
 
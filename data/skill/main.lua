@@ -14,3 +14,53 @@ function skill.list.attack(level)
         perform = skill.default_perform
     }
 end
+
+function skill.list.cleave(level)
+    return {
+        desc = "A wide swing that catches the whole enemy line.",
+        max_level = 5,
+
+        power = 30 + 5 * (level - 1),
+        accuracy = 65 + 5 * (level - 1),
+        method = method.physical,
+        spread = spread.aoe,
+
+        perform = skill.default_perform
+    }
+end
+
+function skill.list.sunder(level)
+    return {
+        desc = "A blow that leaves the target's guard broken.",
+        max_level = 5,
+
+        power = 30 + 5 * (level - 1),
+        accuracy = 75 + 5 * (level - 1),
+        method = method.physical,
+
+        perform = function(s, source, target, targets)
+            skill.default_perform(s, source, target, targets)
+            if not target.is_dead then
+                target:applyEffect(effect.defense_break)
+            end
+        end
+    }
+end
+
+function skill.list.warcry(level)
+    return {
+        desc = "Rallies every ally, boosting their attack for a while.",
+        max_level = 1,
+
+        method = method.none,
+        spread = spread.self,
+
+        perform = function(s, source)
+            -- indexed rather than ipairs, which LuaJIT won't use on a team
+            local team = source:getTeam()
+            for i = 1, #team do
+                team[i]:applyEffect(effect.attack_boost)
+            end
+        end
+    }
+end
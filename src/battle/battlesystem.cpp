@@ -1,22 +1,38 @@
 #include "battle/battlesystem.h"
 
-#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 
 #include "battle/battleview.h"
 #include "battle/controller.h"
 #include "battle/entity.h"
+#include "battle/luamemory.h"
+#include "battle/playercontroller.h"
 #include "util/overload.h"
+#include "util/random.h"
+#include "util/trace.h"
+#include "util/workpool.h"
 
 namespace battle {
 
-BattleSystem::BattleSystem(const std::vector<EntityRef>& blues,
-                           const std::vector<EntityRef>& reds) {
-    combatants.reserve(blues.size() + reds.size());
+namespace {
+    // the seed for one combatant's decision in a phase (splitmix64's finaliser)
+    std::uint32_t decisionSeed(std::uint32_t phase, CombatantHandle c) noexcept {
+        auto z = (std::uint64_t{ phase } << 32 | c) + 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return static_cast<std::uint32_t>(z ^ (z >> 31));
+    }
+}
 
+BattleSystem::BattleSystem(const std::vector<EntityRef>& blues,
+                           const std::vector<EntityRef>& reds)
+    : turn_order{ TurnOrderCmp{ &store } }
+{
     const auto push = [this](Team team, const EntityRef& e) {
         auto dt = diff(e.get());
-        combatants.emplace_back(team, e, 0, dt);
-        turn_order.push(newRef(combatants.size() - 1));
+        turn_order.push(store.add(team, e, { 0, dt }));
     };
 
     for (const auto& e : blues)
@@ -27,45 +43,68 @@ BattleSystem::BattleSystem(const std::vector<EntityRef>& blues,
 
 std::vector<Entity*> BattleSystem::teamMembersOf(Team team) noexcept {
     std::vector<Entity*> entities;
-    for (auto&& c : combatants)
-        if (c.team == team)
-            entities.push_back(c.entity.get());
+    for (std::size_t h = 0; h < store.size(); h++)
+        if (store.teams[h] == team)
+            entities.push_back(store.entities[h].get());
     return entities;
 }
 
 std::vector<const Entity*> BattleSystem::teamMembersOf(Team team) const noexcept {
     std::vector<const Entity*> entities;
-    for (auto&& c : combatants)
-        if (c.team == team)
-            entities.push_back(c.entity.get());
+    for (std::size_t h = 0; h < store.size(); h++)
+        if (store.teams[h] == team)
+            entities.push_back(store.entities[h].get());
     return entities;
 }
 
 Team BattleSystem::teamOf(const Entity& e) const {
-    auto it = std::find_if(
-        std::begin(combatants), std::end(combatants),
-        [&e](auto&& c){ return c.entity.get() == &e; }
-    );
-    if (it == std::end(combatants))
+    if (!store.contains(e))
         throw std::invalid_argument("BattleSystem::teamOf: entity not found");
-    return it->team;
+    return store.teams[store.handleOf(e)];
 }
 
+void BattleSystem::resolveTargets(SkillSpread spread,
+                                  Entity& source, Entity& target,
+                                  std::vector<Entity*>& out)
+{
+    out.clear();
+    switch (spread) {
+    case SkillSpread::Self:
+        out.push_back(&source);
+        break;
 
-// Turn order business
+    case SkillSpread::Single:
+        out.push_back(&target);
+        break;
 
-bool BattleSystem::CombatantRefCmp::operator()
-        (CombatantRef a, CombatantRef b) const noexcept
-{
-    auto& ca = a.get();
-    auto& cb = b.get();
-    if (ca.next_turn == cb.next_turn)
-        return a.index > b.index;
-    return ca.next_turn > cb.next_turn;
+    case SkillSpread::SemiAoE:
+    case SkillSpread::AoE: {
+        const auto team = teamOf(target);
+        for (std::size_t h = 0; h < store.size(); h++)
+            if (store.teams[h] == team && store.pools[h].health > 0)
+                out.push_back(store.entities[h].get());
+        break;
+    }
+
+    case SkillSpread::Field:
+        for (std::size_t h = 0; h < store.size(); h++)
+            if (store.pools[h].health > 0)
+                out.push_back(store.entities[h].get());
+        break;
+    }
 }
 
-BattleSystem::CombatantRef BattleSystem::newRef(std::size_t index) {
-    return CombatantRef{ index, &combatants };
+
+// Turn order business
+
+bool BattleSystem::TurnOrderCmp::operator()
+        (CombatantHandle a, CombatantHandle b) const noexcept
+{
+    const auto ta = store->timelines[a].next_turn;
+    const auto tb = store->timelines[b].next_turn;
+    if (ta == tb)
+        return a > b;
+    return ta > tb;
 }
 
 BattleSystem::Timepoint BattleSystem::diff(const Entity* e) const noexcept {
@@ -74,87 +113,217 @@ BattleSystem::Timepoint BattleSystem::diff(const Entity* e) const noexcept {
 
 void BattleSystem::pushCombatant(Team team, EntityRef e) {
     auto dt = diff(e.get());
-    auto now = turn_order.empty() ? 0 : turn_order.top()->next_turn;
-    combatants.emplace_back(team, std::move(e), now, now + dt);
-    turn_order.push(newRef(combatants.size() - 1));
+    auto now = turn_order.empty() ? 0 : store.timelines[turn_order.top()].next_turn;
+    turn_order.push(store.add(team, std::move(e), { now, now + dt }));
+    revision++;
 }
 
 void BattleSystem::gotoNextTurn() noexcept {
-    auto ref = turn_order.top();
+    auto h = turn_order.top();
     turn_order.pop();
-    ref->last_turn  = ref->next_turn;
-    ref->next_turn += diff(ref->entity.get());
-    turn_order.push(ref);
+    auto& t = store.timelines[h];
+    t.last_turn  = t.next_turn;
+    t.next_turn += diff(store.entities[h].get());
+    turn_order.push(h);
 }
 
 
 // Actually run the game
 
 TurnInfo BattleSystem::doTurn() {
+    TRACE_TURN("BattleSystem::doTurn");
+
+    // a parked turn only goes anywhere once the player has made up their mind
+    if (parked) {
+        if (auto choice = parked->controller->takeChoice())
+            return resume(*choice);
+        return TurnInfo{ false, true, parked->controller, {} };
+    }
+
+    // carry on with the phase in progress, even if phases were just turned off
+    if (phases || !pending.empty())
+        return doPhase();
+
     // skip dead people
-    Combatant& c = *turn_order.top();
-    TurnInfo info { true, false, nullptr, {} };
-    if (c.entity->isDead()) {
+    const auto c = turn_order.top();
+    TurnInfo info { true, false, nullptr, newLogger() };
+    if (store.pools[c].health <= 0) {
         gotoNextTurn();
         return info;
     }
 
-    BattleView view {
-        teamMembersOf(c.team == Team::Blue ? Team::Blue : Team::Red),
-        teamMembersOf(c.team == Team::Blue ? Team::Red : Team::Blue)
+    const auto view = viewFor(store.teams[c]);
+
+    auto& controller = store.entities[c]->getController();
+    Action act = [&] {
+        TRACE_SCOPE("Controller::go");
+        return controller.go(view);
+    }();
+
+    perform(c, act, info);
+    return info;
+}
+
+void BattleSystem::setPhaseMode(bool enabled, util::WorkPool* pool) noexcept {
+    phases = enabled;
+    phase_pool = pool;
+}
+
+TurnInfo BattleSystem::doPhase() {
+    if (pending.empty())
+        decidePhase();
+
+    // carry everything out in turn order, as though nobody went at once
+    TurnInfo info { true, false, nullptr, newLogger() };
+    while (!pending.empty() && !parked) {
+        auto [c, act] = std::move(pending.front());
+        pending.pop_front();
+
+        // killed earlier in the phase (or already dead)
+        if (!act || store.pools[c].health <= 0) {
+            gotoNextTurn();
+            continue;
+        }
+        perform(c, *act, info);
+    }
+    return info;
+}
+
+void BattleSystem::decidePhase() {
+    TRACE_SCOPE("BattleSystem::decidePhase");
+
+    // everyone due at the same moment as whoever's next, in turn order
+    std::vector<CombatantHandle> due;
+    const auto now = store.timelines[turn_order.top()].next_turn;
+    while (!turn_order.empty() && store.timelines[turn_order.top()].next_turn == now) {
+        due.push_back(turn_order.top());
+        turn_order.pop();
+    }
+    for (auto c : due)
+        turn_order.push(c);
+
+    // controllers may run on other threads, so nothing they look at can be
+    // worked out lazily: fill in every cached stat block beforehand
+    for (CombatantHandle h = 0; h < store.size(); h++)
+        (void)store.effectiveStats(h);
+
+    // likewise the blackboards, which are worked out here once for everyone
+    const auto blue_view = viewFor(Team::Blue);
+    const auto red_view = viewFor(Team::Red);
+
+    // each decision gets its own seed, so it doesn't matter who makes it
+    const auto phase_seed = util::random(std::numeric_limits<std::uint32_t>::max());
+
+    std::vector<std::optional<Action>> chosen(due.size());
+    const bool traced = TRACE_TRACING_TURN();
+    const auto decide = [&](std::size_t i) {
+        const auto c = due[i];
+        if (store.pools[c].health <= 0)
+            return;
+
+        util::SeedScope seed{ decisionSeed(phase_seed, c) };
+        TRACE_FOLLOW(traced);
+        TRACE_SCOPE("Controller::go");
+        chosen[i].emplace(store.entities[c]->getController().go(
+                store.teams[c] == Team::Blue ? blue_view : red_view));
     };
 
-    auto& controller = c.entity->getController();
-    Action act = controller.go(view);
+    if (phase_pool && due.size() > 1) {
+        phase_pool->run(due.size(), decide);
+    } else {
+        for (std::size_t i = 0; i < due.size(); i++)
+            decide(i);
+    }
+
+    for (std::size_t i = 0; i < due.size(); i++)
+        pending.emplace_back(due[i], std::move(chosen[i]));
+}
+
+PlayerController* BattleSystem::awaitingInput() const noexcept {
+    return parked ? parked->controller : nullptr;
+}
+
+TurnInfo BattleSystem::resume(const Action& act) {
+    if (!parked)
+        throw std::runtime_error("BattleSystem::resume: not waiting for input");
+
+    const auto c = parked->combatant;
+    parked = std::nullopt;
+
+    TurnInfo info { true, false, nullptr, newLogger() };
+    Action copy = act;
+    perform(c, copy, info);
+    return info;
+}
+
+void BattleSystem::perform(CombatantHandle c, Action& act, TurnInfo& info) {
+    TRACE_SCOPE("BattleSystem::perform");
 
+    Entity& self = *store.entities[c];
     std::visit(util::overload{
-        [&info,c](action::Defend){
+        [&info,&self](action::Defend){
             // at this stage, do nothing ;)
-            info.messages.appendMessage(message::Defended{ *c.entity });
+            info.messages.appendMessage(message::Defended{ self });
             info.turn_finished = true;
         },
-        [&info,c](action::Flee){
+        [&info,&self](action::Flee){
             // at this stage, do nothing ;)
-            info.messages.appendMessage(message::Fled{ *c.entity, true });
+            info.messages.appendMessage(message::Fled{ self, true });
             info.turn_finished = true;
         },
-        [&info,c,this](action::Skill& s){
-            auto it = std::find_if(
-                std::begin(combatants), std::end(combatants),
-                [&s](auto&& c){ return c.entity.get() == &s.target; }
-            );
-            if (it != std::end(combatants)) {
-                s.skill->use(info.messages, *c.entity, *it->entity, *this);
+        [&info,&self,this](action::Skill& s){
+            if (store.contains(s.target)) {
+                s.skill->use(info.messages, self,
+                             *store.entities[store.handleOf(s.target)], *this);
                 info.turn_finished = true;
             } else {
                 throw std::invalid_argument(
                         "BattleSystem::doTurn/Skill: entity not found");
             }
         },
-        [&info](action::UserChoice user) {
+        [&info,&c,this](action::UserChoice user) {
             info.turn_finished = false;
             info.need_user_input = true;
             info.controller = &user.controller;
+            parked = Parked{ c, &user.controller };
         }
     }, act);
 
     if (info.turn_finished) {
-        if (!c.entity->isDead())
-            c.entity->processTurnEnd(info.messages);
+        if (!self.isDead()) {
+            TRACE_SCOPE("Entity::processTurnEnd");
+            self.processTurnEnd(info.messages);
+        }
         gotoNextTurn();
-    }
+        revision++;
 
-    return info;
+        // the collector only runs here, between turns, never during a skill
+        TRACE_SCOPE("stepLuaCollector");
+        stepLuaCollector();
+    }
 }
 
-bool BattleSystem::isDone() const noexcept {
-    const auto is_dead = [](const Entity* e){ return e->isDead(); };
+const TeamBlackboard& BattleSystem::blackboard(Team team) {
+    auto& board = boards[static_cast<std::size_t>(team)];
+    if (board.revision != revision)
+        board.refresh(store, team, revision);
+    return board;
+}
 
-    const auto red  = teamMembersOf(Team::Red);
-    const auto blue = teamMembersOf(Team::Blue);
+BattleView BattleSystem::viewFor(Team team) {
+    TRACE_SCOPE("BattleView");
+    const auto other = team == Team::Blue ? Team::Red : Team::Blue;
+    return BattleView{ teamMembersOf(team), teamMembersOf(other), &blackboard(team) };
+}
 
-    return std::all_of(std::begin(red), std::end(red), is_dead)
-        || std::all_of(std::begin(blue), std::end(blue), is_dead);
+bool BattleSystem::isDone() const noexcept {
+    // a team is out once none of them have any health left
+    bool blue_alive = false, red_alive = false;
+    for (std::size_t h = 0; h < store.size(); h++) {
+        if (store.pools[h].health > 0)
+            (store.teams[h] == Team::Blue ? blue_alive : red_alive) = true;
+    }
+    return !blue_alive || !red_alive;
 }
 
 }
@@ -1,30 +1,34 @@
 #ifndef BATTLE_BATTLESYSTEM_H_INCLUDED
 #define BATTLE_BATTLESYSTEM_H_INCLUDED
 
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <vector>
 #include <utility>
 #include <memory>
+#include <optional>
 #include <queue>
+#include "battle/action.h"
+#include "battle/blackboard.h"
+#include "battle/combatantstore.h"
 #include "battle/messages.h"
+#include "battle/skilldetails.h"
+
+namespace util { class WorkPool; }
 
 namespace battle {
 
 class Entity;
 class PlayerController;
-
-/// Which team the entity is on.
-/// Order determines turn priority in case of a tie.
-enum class Team {
-    Blue,  ///< players
-    Red,   ///< enemies
-};
+struct BattleView;
 
 /// Contains information about the happenings of the last turn
 struct TurnInfo {
     bool turn_finished; ///< whether the current entity's turn finished
-    bool need_user_input; ///< whether we now need user input
+    bool need_user_input; ///< whether we now need user input (see BattleSystem::resume)
     PlayerController* controller; ///< the user's controller (if needing user input)
-    MessageLogger messages; ///< what happened since the last turn
+    MessageLogger messages; ///< what happened since the last turn (unless streamed)
 };
 
 /// Manages and runs the battle; the game loop, if you will.
@@ -62,56 +66,111 @@ public:
     /// Get the team the specified entity belongs to
     Team teamOf(const Entity& e) const;
 
+    /// Resolve every entity affected by a skill of the given spread.
+    /// `out' is cleared first, so callers can keep reusing its storage.
+    void resolveTargets(SkillSpread spread, Entity& source, Entity& target,
+                        std::vector<Entity*>& out);
+
     /// Progress the battle.
+    ///
+    /// If the battle is waiting on a player, this doesn't go back to their
+    /// controller each time; it just checks whether they've `choose'n yet.
     TurnInfo doTurn();
 
+    /// The player the battle is waiting on, if any
+    ///
+    /// Once a player's controller asks for input the battle is parked: it
+    /// won't move on until that player's action turns up, either through
+    /// their controller's `choose' or by passing it to `resume'.
+    [[nodiscard]] PlayerController* awaitingInput() const noexcept;
+
+    /// Stream every message straight to `sink' as it happens, rather than
+    /// collecting them into each TurnInfo. The sink must outlive the battle
+    /// (or be replaced first); pass std::nullopt to go back to collecting.
+    void setMessageSink(std::optional<MessageSink> sink) noexcept {
+        this->sink = sink;
+    }
+
+    /// Resolve turns a phase at a time
+    ///
+    /// In phase mode, everyone whose turn comes up at the same moment chooses
+    /// what to do together, all looking at the battle as it was before any of
+    /// them acted; their actions are then carried out one after another in the
+    /// usual turn order, skipping anyone killed in the meantime. One `doTurn'
+    /// resolves the whole phase (or as much of it as comes before a player
+    /// who still has to choose).
+    ///
+    /// Given a pool, the choosing is shared out over its threads. Controllers
+    /// must then only look at the battle, not change it or call into lua, as
+    /// each thread has its own lua state. Each choice is made with the random
+    /// generator seeded especially for it, so a seeded battle turns out the
+    /// same however many threads there are (or whether there's a pool at all).
+    /// The pool must outlive the battle, or be replaced first.
+    void setPhaseMode(bool enabled, util::WorkPool* pool = nullptr) noexcept;
+
+    /// Finish the parked turn with the player's chosen action.
+    /// Throws std::runtime_error if the battle isn't waiting on anyone.
+    TurnInfo resume(const Action& act);
+
     /// Has the battle finished yet?
     bool isDone() const noexcept;
 
+    /// What `team' knows about the battle as it stands, shared by its
+    /// controllers through their BattleView
+    const TeamBlackboard& blackboard(Team team);
+
 private:
     using Timepoint = double;
-    struct Combatant {
-        Team team;
-        EntityRef entity;
-
-        /// What time the next turn for this combatant happens
-        Timepoint last_turn;
-        Timepoint next_turn;
-
-        // TODO: C++20 get rid of this unnecessary constructor
-        Combatant(Team team, EntityRef entity, Timepoint last_turn, Timepoint next_turn)
-            : team{ team }
-            , entity{ entity }
-            , last_turn{ last_turn }
-            , next_turn{ next_turn }
-        {}
-    };
 
-    struct CombatantRef {
-        std::size_t index;
-        std::vector<Combatant>* combatants;
+    /// Every combatant, living and dead, along with their hot state
+    CombatantStore store;
 
-        Combatant& get() const noexcept { return (*combatants)[index]; }
-        Combatant* operator->() const noexcept { return &get(); }
-        Combatant& operator*() const noexcept { return get(); }
+    /// Orders handles by who goes next
+    struct TurnOrderCmp {
+        const CombatantStore* store;
+        bool operator()(CombatantHandle a, CombatantHandle b) const noexcept;
     };
 
-    struct CombatantRefCmp {
-        bool operator()(CombatantRef a, CombatantRef b) const noexcept;
+    /// List of combatants, in order of who goes next
+    std::priority_queue<
+        CombatantHandle, std::vector<CombatantHandle>, TurnOrderCmp> turn_order;
+
+    /// Takes the current turn at sticks it back into the queue
+    void gotoNextTurn() noexcept;
+
+    /// Carry out `act' for the combatant whose turn it is
+    void perform(CombatantHandle c, Action& act, TurnInfo& info);
+
+    /// The turn that's waiting on a player (see `awaitingInput')
+    struct Parked {
+        CombatantHandle combatant;
+        PlayerController* controller;
     };
+    std::optional<Parked> parked = std::nullopt;
 
-    /// The list of all combatants, living and dead
-    std::vector<Combatant> combatants = {};
+    bool phases = false;
+    util::WorkPool* phase_pool = nullptr;
 
-    /// Create a ref referring to the combatant with given index
-    CombatantRef newRef(std::size_t index);
+    /// What everyone in the current phase chose, still to be carried out
+    /// (nothing if they were dead when it came to choosing)
+    std::deque<std::pair<CombatantHandle, std::optional<Action>>> pending;
 
-    /// List of references to combatants, in order of who goes next
-    std::priority_queue<
-        CombatantRef, std::vector<CombatantRef>, CombatantRefCmp> turn_order = {};
+    TurnInfo doPhase();
+    void decidePhase();
 
-    /// Takes the current turn at sticks it back into the queue
-    void gotoNextTurn() noexcept;
+    std::optional<MessageSink> sink = std::nullopt;
+
+    /// Goes up whenever a turn (or a new combatant) might have changed things
+    std::uint64_t revision = 1;
+    std::array<TeamBlackboard, 2> boards;  ///< indexed by team
+
+    /// Everything `team' is allowed to see, as it stands
+    BattleView viewFor(Team team);
+
+    /// Somewhere to put this turn's messages
+    [[nodiscard]] MessageLogger newLogger() const noexcept {
+        return sink ? MessageLogger{ *sink } : MessageLogger{};
+    }
 
     /// Get the timestep difference
     Timepoint diff(const Entity* e) const noexcept;
@@ -7,12 +7,15 @@ namespace battle {
 
 
 class Entity;
+struct TeamBlackboard;
 
 // Observe the current state of the battle
 // TODO: make more const correct (anyone can modify atm)
 struct BattleView {
     std::vector<Entity*> allies;
     std::vector<Entity*> enemies;
+    /// What the viewer's team knows, shared with the rest of it (may be null)
+    const TeamBlackboard* board;
 };
 
 
@@ -0,0 +1,181 @@
+#include "battle/blackboard.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "battle/damage.h"
+#include "battle/entity.h"
+#include "battle/skill.h"
+#include "battle/skilldetails.h"
+#include "util/trace.h"
+
+namespace battle {
+
+namespace {
+
+    // what a skill is worth in one turn, from the damage it could expect to
+    // do to each of the team: the most to any one of them, or the total
+    double spreadValue(SkillSpread spread, double total, double most) noexcept {
+        switch (spread) {
+        case SkillSpread::Self:
+            return 0.0;
+        case SkillSpread::Single:
+            return most;
+        case SkillSpread::SemiAoE:
+            return most + 0.7 * (total - most);
+        case SkillSpread::AoE:
+        case SkillSpread::Field:
+            return total;
+        }
+        return 0.0;
+    }
+
+    double expectedDamage(const CombatantStore& store, const DamageSkill& skill,
+                          CombatantHandle source, CombatantHandle target) noexcept
+    {
+        const auto resist = store.resistances(target)[static_cast<std::size_t>(skill.element)];
+        return damageOdds(skill, store.effectiveStats(source),
+                          store.effectiveStats(target), resist).expected();
+    }
+
+}
+
+void TeamBlackboard::refresh(const CombatantStore& store, Team team, std::uint64_t rev) {
+    TRACE_SCOPE("TeamBlackboard::refresh");
+    revision = rev;
+    allies.clear();
+    enemies.clear();
+    threat.clear();
+    focus = nullptr;
+    mine.clear();
+    theirs.clear();
+    changed_allies.clear();
+    changed_enemies.clear();
+
+    if (seen.size() != store.size()) {
+        seen_revisions.resize(store.size());
+        seen_usable.resize(store.size());
+        seen_alive.resize(store.size());
+        seen.resize(store.size(), false);
+        skills_of.resize(store.size());
+        threat_of.resize(store.size(), 0.0);
+        for (auto& skills : skills_of)
+            for (auto& st : skills)
+                st.parts.resize(store.size(), 0.0);
+    }
+    rebuilt.assign(store.size(), false);
+
+    for (CombatantHandle h = 0; h < store.size(); h++) {
+        const bool alive = store.pools[h].health > 0;
+        const auto rev = store.entities[h]->getStatsRevision();
+        const auto usable = store.entities[h]->getUsableSkillsRevision();
+        const bool ours = store.teams[h] == team;
+        // what an ally can use doesn't change how hard they're hit, but what
+        // an enemy can use changes how hard they hit
+        if (!seen[h] || seen_alive[h] != alive || seen_revisions[h] != rev
+            || (!ours && seen_usable[h] != usable))
+            (ours ? changed_allies : changed_enemies).push_back(h);
+        seen[h] = true;
+        seen_alive[h] = alive;
+        seen_revisions[h] = rev;
+        seen_usable[h] = usable;
+        if (alive)
+            (ours ? mine : theirs).push_back(h);
+    }
+    for (auto h : mine)
+        allies.push_back(store.entities[h].get());
+
+    // an enemy whose own stats or skills changed is worked out again from
+    // scratch; otherwise only the parts for allies who changed need redoing
+    for (auto h : changed_enemies) {
+        rebuildEnemy(store, h);
+        rebuilt[h] = true;
+    }
+    if (!changed_allies.empty()) {
+        for (auto e : theirs) {
+            if (rebuilt[e])
+                continue;
+            for (auto& st : skills_of[e])
+                for (auto a : changed_allies)
+                    updateAlly(store, st, e, a, seen_alive[a]);
+        }
+    }
+
+    // a turn comes around every 100 / react, so scale a turn's damage by that
+    if (!changed_allies.empty() || !changed_enemies.empty())
+        for (auto h : theirs)
+            threat_of[h] = bestTurn(h) * store.effectiveStats(h).react / 100.0;
+
+    double best_ratio = -1.0;
+    for (auto h : theirs) {
+        const double t = threat_of[h];
+        const double ratio = t / store.pools[h].health;
+        enemies.push_back(store.entities[h].get());
+        threat.push_back(t);
+        if (ratio > best_ratio) {
+            best_ratio = ratio;
+            focus = enemies.back();
+        }
+    }
+}
+
+void TeamBlackboard::rebuildEnemy(const CombatantStore& store, CombatantHandle enemy) {
+    auto& skills = skills_of[enemy];
+    skills.clear();
+    if (!seen_alive[enemy])
+        return;
+
+    for (SkillRef usable : store.entities[enemy]->getUsableSkills()) {
+        const auto skill = damageSkillOf(usable->getDetails());
+        if (!skill)
+            continue;
+
+        SkillThreat st{ *skill, std::vector<double>(store.size(), 0.0) };
+        for (auto h : mine) {
+            const double expected = expectedDamage(store, st.skill, enemy, h);
+            st.parts[h] = expected;
+            st.total += expected;
+            st.most = std::max(st.most, expected);
+        }
+        skills.push_back(std::move(st));
+    }
+}
+
+void TeamBlackboard::updateAlly(const CombatantStore& store, SkillThreat& st,
+                                CombatantHandle enemy, CombatantHandle ally, bool alive)
+{
+    const double old = st.parts[ally];
+    const double now = alive ? expectedDamage(store, st.skill, enemy, ally) : 0.0;
+    st.parts[ally] = now;
+    st.total += now - old;
+    if (now >= st.most) {
+        st.most = now;
+    } else if (old == st.most) {
+        // the one doing the most went down; find who does now (and take the
+        // chance to shed any rounding the running total has picked up)
+        st.most = 0.0;
+        st.total = 0.0;
+        for (double part : st.parts) {
+            st.most = std::max(st.most, part);
+            st.total += part;
+        }
+    }
+}
+
+double TeamBlackboard::bestTurn(CombatantHandle enemy) const noexcept {
+    double best = 0.0;
+    for (const auto& st : skills_of[enemy])
+        best = std::max(best, spreadValue(st.skill.spread, st.total, st.most));
+    return best;
+}
+
+double TeamBlackboard::threatOf(const Entity& enemy) const noexcept {
+    const auto it = std::find(std::begin(enemies), std::end(enemies), &enemy);
+    if (it == std::end(enemies))
+        return 0.0;
+    return threat[static_cast<std::size_t>(it - std::begin(enemies))];
+}
+
+
+}
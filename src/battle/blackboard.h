@@ -0,0 +1,73 @@
+#ifndef BATTLE_BLACKBOARD_H_INCLUDED
+#define BATTLE_BLACKBOARD_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "battle/combatantstore.h"
+#include "battle/damage.h"
+
+namespace battle {
+
+
+class Entity;
+
+/// What one team's controllers know about the battle
+///
+/// The battle system works this out once per change to the battle, and every
+/// controller on the team reads the same copy, rather than each of them
+/// going over the battlefield for themselves. Sharing a focus target also
+/// means a group of NPCs gangs up on someone instead of spreading its damage.
+struct TeamBlackboard {
+    /// The battle system's revision this was worked out for
+    std::uint64_t revision = 0;
+
+    std::vector<Entity*> allies;   ///< the team's living members
+    std::vector<Entity*> enemies;  ///< the other team's living members
+
+    /// For each of `enemies', the damage they can be expected to deal to the
+    /// team per unit of battle time, going by the best skill they can use
+    std::vector<double> threat;
+
+    /// The enemy to gang up on: the most threat for the least health
+    /// (nullptr when there are no enemies left)
+    Entity* focus = nullptr;
+
+    /// Work it all out again for `team', from the state in `store'
+    void refresh(const CombatantStore& store, Team team, std::uint64_t revision);
+
+    /// The threat of one of `enemies', or 0 if they aren't one
+    [[nodiscard]] double threatOf(const Entity& enemy) const noexcept;
+
+private:
+    /// One of an enemy's damaging skills, and what it would do to each ally
+    struct SkillThreat {
+        DamageSkill skill;
+        std::vector<double> parts;  ///< expected damage, by handle (0 if dead)
+        double total = 0.0;         ///< of `parts'
+        double most = 0.0;          ///< the largest of `parts'
+    };
+
+    void rebuildEnemy(const CombatantStore& store, CombatantHandle enemy);
+    void updateAlly(const CombatantStore& store, SkillThreat& st,
+                    CombatantHandle enemy, CombatantHandle ally, bool alive);
+    [[nodiscard]] double bestTurn(CombatantHandle enemy) const noexcept;
+
+    // threat only depends on stats, usable skills and who's still standing,
+    // which change far less often than health does, so it's kept (per handle)
+    // between refreshes; and when one combatant changes, only their part is
+    // redone
+    std::vector<std::uint32_t> seen_revisions;
+    std::vector<std::uint32_t> seen_usable;
+    std::vector<bool> seen_alive;
+    std::vector<bool> seen;                         ///< whether looked at yet
+    std::vector<std::vector<SkillThreat>> skills_of;  ///< by enemy handle
+    std::vector<double> threat_of;
+    std::vector<CombatantHandle> mine, theirs;  ///< living, by team
+    std::vector<CombatantHandle> changed_allies, changed_enemies;
+    std::vector<bool> rebuilt;  ///< enemies worked out from scratch this time
+};
+
+
+}
+
+#endif // BATTLE_BLACKBOARD_H_INCLUDED
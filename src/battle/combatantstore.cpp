@@ -0,0 +1,75 @@
+#include "battle/combatantstore.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include "battle/entity.h"
+
+namespace battle {
+
+
+CombatantStore::~CombatantStore() {
+    // hand everyone's state back, so the entities carry on working without us
+    for (std::size_t h = 0; h < entities.size(); h++) {
+        auto& e = *entities[h];
+        e.own_pools = pools[h];
+        e.own_effects = std::move(effects[h]);
+        e.store = nullptr;
+        e.handle = 0;
+    }
+}
+
+CombatantHandle CombatantStore::add(Team team, std::shared_ptr<Entity> e, Timeline when) {
+    if (!e)
+        throw std::invalid_argument("CombatantStore::add: no entity");
+    if (e->store)
+        throw std::invalid_argument("CombatantStore::add: '" + e->getID().name +
+                                    "' is already in a battle");
+
+    // make room everywhere first, so nothing is left half added
+    const auto grow = [](auto& v) {
+        if (v.size() == v.capacity())
+            v.reserve(v.capacity() * 2 + 4);
+    };
+    grow(entities); grow(teams); grow(timelines);
+    grow(pools); grow(effects); grow(stats); grow(resists); grow(stale);
+
+    const auto h = static_cast<CombatantHandle>(entities.size());
+    teams.push_back(team);
+    timelines.push_back(when);
+    pools.push_back(e->own_pools);
+    effects.push_back(std::move(e->own_effects));
+    stats.emplace_back();
+    resists.emplace_back();
+    stale.push_back(true);
+
+    e->store = this;
+    e->handle = h;
+    entities.push_back(std::move(e));
+    return h;
+}
+
+bool CombatantStore::contains(const Entity& e) const noexcept {
+    return e.store == this;
+}
+
+CombatantHandle CombatantStore::handleOf(const Entity& e) const noexcept {
+    return e.handle;
+}
+
+const Stats& CombatantStore::effectiveStats(CombatantHandle h) const noexcept {
+    if (stale[h]) {
+        stats[h] = entities[h]->computeStats();
+        resists[h] = effectiveResistances(stats[h]);
+        stale[h] = false;
+    }
+    return stats[h];
+}
+
+const Resistances& CombatantStore::resistances(CombatantHandle h) const noexcept {
+    (void)effectiveStats(h);
+    return resists[h];
+}
+
+
+}
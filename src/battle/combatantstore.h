@@ -0,0 +1,94 @@
+#ifndef BATTLE_COMBATANTSTORE_H_INCLUDED
+#define BATTLE_COMBATANTSTORE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "battle/stats.h"
+#include "battle/statuseffect.h"
+
+namespace battle {
+
+
+class Entity;
+
+/// Which team the entity is on.
+/// Order determines turn priority in case of a tie.
+enum class Team {
+    Blue,  ///< players
+    Red,   ///< enemies
+};
+
+/// Identifies a combatant within its CombatantStore
+using CombatantHandle = std::uint32_t;
+
+/// An entity's remaining pools
+struct Pools {
+    int health;  ///< remaining health
+    int mana;    ///< remaining magic
+    int tech;    ///< remaining tech
+};
+
+/// When a combatant's turns come around
+struct Timeline {
+    double last_turn;
+    double next_turn;
+};
+
+/// The hot state of every combatant in a battle, one dense array per component
+///
+/// Entity is still the way to get at a combatant, but while it's in a battle
+/// its pools and effects live here (see Entity::getPools and friends), along
+/// with a cache of its effective stats (and resistances) and the battle's
+/// own bookkeeping: its team and its place in the timeline. Loops that only
+/// need a field or two of each combatant -- who's dead, who's on which team,
+/// whose turn is next -- then walk along an array rather than hopping
+/// between entities.
+///
+/// Combatants are never removed; a handle is just an index into the arrays.
+/// Entities are handed back their state when the store goes away.
+class CombatantStore {
+public:
+    CombatantStore() = default;
+    ~CombatantStore();
+
+    CombatantStore(const CombatantStore&) = delete;
+    CombatantStore& operator=(const CombatantStore&) = delete;
+
+    /// Add an entity to the store, moving its state in.
+    /// Throws std::invalid_argument if it's already in a store.
+    CombatantHandle add(Team team, std::shared_ptr<Entity> e, Timeline when);
+
+    [[nodiscard]] std::size_t size() const noexcept { return entities.size(); }
+
+    /// The handle for an entity, if it's in this store
+    [[nodiscard]] bool contains(const Entity& e) const noexcept;
+    [[nodiscard]] CombatantHandle handleOf(const Entity& e) const noexcept;
+
+    // components, indexed by handle
+    std::vector<std::shared_ptr<Entity>> entities;
+    std::vector<Team> teams;
+    std::vector<Timeline> timelines;
+    std::vector<Pools> pools;
+    std::vector<std::vector<StatusEffect>> effects;
+
+    /// The entity's stats with its effects applied, worked out as needed
+    [[nodiscard]] const Stats& effectiveStats(CombatantHandle h) const noexcept;
+
+    /// Resistances worked out from `effectiveStats', cached alongside them
+    [[nodiscard]] const Resistances& resistances(CombatantHandle h) const noexcept;
+
+    /// Call when something changes what `effectiveStats' should give
+    void invalidateStats(CombatantHandle h) noexcept { stale[h] = true; }
+
+private:
+    mutable std::vector<Stats> stats;
+    mutable std::vector<Resistances> resists;
+    mutable std::vector<std::uint8_t> stale;
+};
+
+
+}
+
+#endif // BATTLE_COMBATANTSTORE_H_INCLUDED
@@ -1,12 +1,26 @@
 #include "battle/battlesystem.h"
+#include "battle/damage.h"
 #include "battle/entity.h"
+#include "battle/luaallocator.h"
+#include "battle/luamemory.h"
 #include "battle/skill.h"
 #include "battle/skilldetails.h"
+#include "battle/skillprofile.h"
 #include "battle/stats.h"
+#include "battle/statuseffect.h"
 #include "util/random.h"
+#include "util/symbol.h"
+#include "util/trace.h"
 
 #include <type_traits>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #define SOL_CHECK_ARGUMENTS 1
 #include <sol/sol.hpp>
@@ -23,12 +37,19 @@ namespace {
 
         operator Entity&() noexcept { return *entity; }
 
+        // two loggers are the same if they refer to the same entity
+        friend bool operator==(const EntityLogger& lhs, const EntityLogger& rhs) noexcept {
+            return lhs.entity == rhs.entity;
+        }
+
         Stats& getStats() {
             if (!stat_cache)
                 stat_cache = entity->getStats();
             return *stat_cache;
         }
 
+        void forgetStats() noexcept { stat_cache.reset(); }
+
         Entity* entity;
         BattleSystem* system;
         MessageLogger* logger;
@@ -83,19 +104,26 @@ namespace {
     }
 
 
+    // a symbol's text as a lua string, made once per thread (see below)
+    const sol::object& luaSymbol(util::Symbol sym);
+
     void loadEntityLoggerMetatable(sol::state_view& lua) {
         auto metatable = lua.new_usertype<EntityLogger>("logged_entity",
             "new", sol::no_constructor);
 
-        auto get_id_field = [](auto field) {
+        auto get_symbol = [](util::Symbol EntityID::* field) {
             return sol::readonly_property(
-                [field](const EntityLogger& el){ return el.entity->getID().*field; }
+                [field](const EntityLogger& el) -> const sol::object& {
+                    return luaSymbol(el.entity->getID().*field);
+                }
             );
         };
 
-        metatable["kind"] = get_id_field(&EntityID::kind);
-        metatable["type"] = get_id_field(&EntityID::type);
-        metatable["name"] = get_id_field(&EntityID::name);
+        metatable["kind"] = get_symbol(&EntityID::kind);
+        metatable["type"] = get_symbol(&EntityID::type);
+        metatable["name"] = sol::readonly_property(
+            [](const EntityLogger& el){ return el.entity->getID().name; }
+        );
 
         metatable["stats"] = sol::readonly_property(&EntityLogger::getStats);
 
@@ -112,6 +140,18 @@ namespace {
 
         metatable["is_dead"] = wrap_entity_property(&Entity::isDead);
 
+        metatable["applyEffect"] = [](EntityLogger& el, StatusEffectId id) {
+            el.entity->applyStatusEffect(*el.logger, StatusEffect{ id });
+            el.forgetStats();
+        };
+
+        // whether two handles refer to the same entity; unlike `==' this
+        // works the same under LuaJIT, which only calls `__eq' when both
+        // sides share a metatable (not true for the entries in `targets')
+        metatable["is"] = [](const EntityLogger& self, const EntityLogger& other) {
+            return self == other;
+        };
+
         // need to do this because GCC has a bug;
         // see https://gcc.gnu.org/bugzilla/show_bug.cgi?id=64194
         auto getHealth = &Entity::get<Pool::Health>;
@@ -121,6 +161,11 @@ namespace {
         metatable["mana"] = wrap_entity_property(getMana);
         metatable["tech"] = wrap_entity_property(getTech);
 
+        // overall resistance to an element, secondary elements and all
+        metatable["resists"] = [](const EntityLogger& el, Element e) {
+            return el.entity->getResistance(e);
+        };
+
         metatable["getTeam"] = [](EntityLogger& el) {
             // create a new logged entity for every living member in the team
             const auto members = el.system->teamMembersOf(el);
@@ -144,6 +189,8 @@ namespace {
         };
     }
 
+    void loadTargetSetMetatable(sol::state_view& lua);
+
     void loadStatsMetatable(sol::state_view& lua) {
         auto metatable = lua.new_usertype<Stats>("stats");
 
@@ -199,6 +246,13 @@ namespace {
         });
     }
 
+    void loadEffects(sol::state_view& lua) {
+        lua.new_enum<StatusEffectId>("effect", {
+            { "attack_boost",  StatusEffectId::AttackBoost },
+            { "defense_break", StatusEffectId::DefenseBreak },
+        });
+    }
+
     void loadMessageTypes(sol::state_view& lua) {
         // TODO: redesign how this is done - maybe put this in "skill"?
         auto msg = lua["message"].get_or_create<sol::table>();
@@ -213,6 +267,8 @@ namespace {
         };
     }
 
+    void loadNativeSkillFunctions(sol::state_view& lua);
+
     void loadLuaPackages(sol::state_view& lua) {
         // now that we've set up all the usertypes, we're safe to load the
         // current list of possible skills
@@ -225,9 +281,26 @@ namespace {
         );
     }
 
+#ifndef SOL_LUAJIT
+    LuaAllocator& allocator() {
+        thread_local LuaAllocator a;
+        return a;
+    }
+#endif
+
+    // Every thread gets its own lua state, loaded on first use. Skills hold
+    // onto tables in the state they were created in, so a skill (and thus
+    // any entity or battle using it) must stay on the thread that made it.
     sol::state_view lua() {
-        static sol::state lua = [](){
+        thread_local sol::state lua = [](){
+#ifdef SOL_LUAJIT
+            // LuaJIT (on x64, at least) doesn't cope with another allocator
             sol::state lua;
+#else
+            // the allocator is made first, so it's destroyed after the state
+            sol::state lua{ sol::default_at_panic, &LuaAllocator::alloc, &allocator() };
+            allocator().setLimit(default_lua_memory_limit);
+#endif
 
             // load base lua libraries
             lua.open_libraries(
@@ -235,6 +308,10 @@ namespace {
                 sol::lib::math,    // math fns
                 sol::lib::package  // require (TODO: do we want this?)
             );
+#ifdef SOL_LUAJIT
+            // the JIT compiler is only switched on once its library is loaded
+            lua.open_libraries(sol::lib::jit);
+#endif
 
             // prevent accidentally loading weird libraries and make sure we
             // actually get the libraries we *do* want
@@ -257,9 +334,12 @@ namespace {
             // load types and metatables
             loadSkillEnums(lua);
             loadElements(lua);
+            loadEffects(lua);
             loadEntityLoggerMetatable(lua);
+            loadTargetSetMetatable(lua);
             loadStatsMetatable(lua);
             loadMessageTypes(lua);
+            loadNativeSkillFunctions(lua);
 
             // set default logging global
             lua.script(R"(
@@ -272,12 +352,31 @@ namespace {
             // actually load the config files
             loadLuaPackages(lua);
 
+            // from here on, the host decides when to collect (see luamemory.h)
+            lua.collect_garbage();
+            lua_gc(lua, LUA_GCSTOP, 0);
+
             return lua;
         }();
 
         return lua;
     }
 
+    const sol::object& luaSymbol(util::Symbol sym) {
+        // kept in a reference, so handing it to lua is a registry lookup
+        // rather than hashing the text again every time it's asked for;
+        // made after the state, so they're destroyed before it at thread exit
+        (void)lua();
+        thread_local std::vector<sol::object> strings;
+
+        if (sym.id() >= strings.size())
+            strings.resize(sym.id() + 1);
+        auto& s = strings[sym.id()];
+        if (!s.valid())
+            s = sol::make_object(lua(), sym.str());
+        return s;
+    }
+
     /// RAII wrapper for setting the log function in lua
     /// This way log calls the right thing while giving errors when it's not
     /// supposed to be available
@@ -302,6 +401,307 @@ namespace {
     [[nodiscard]] auto set_log(Fn&& fn) {
         return ScopedLogger(std::forward<Fn>(fn));
     }
+
+    /// The pre-resolved set of entities affected by a skill
+    ///
+    /// This is filled natively before every `perform' and handed to lua as
+    /// a single long-lived userdata. Each slot also keeps its own userdata
+    /// alive between calls, so indexing the set never creates lua garbage.
+    class TargetSet {
+    public:
+        TargetSet()
+            : self{ sol::make_object(lua(), std::ref(*this)) }
+        {}
+
+        // the handles refer back into this object
+        TargetSet(const TargetSet&) = delete;
+        TargetSet& operator=(const TargetSet&) = delete;
+
+        /// Work out who `source' hits when using a skill of `spread' on `target'
+        void resolve(SkillSpread spread, Entity& source, Entity& target,
+                     BattleSystem& system, MessageLogger& logger)
+        {
+            system.resolveTargets(spread, source, target, resolved);
+
+            while (slots.size() < resolved.size()) {
+                slots.push_back(std::make_unique<EntityLogger>(nullptr, nullptr, nullptr));
+                handles.push_back(sol::make_object(lua(), std::ref(*slots.back())));
+            }
+            for (std::size_t i = 0; i < resolved.size(); i++)
+                *slots[i] = EntityLogger{ resolved[i], &system, &logger };
+            count = resolved.size();
+        }
+
+        /// The lua handle for this set
+        [[nodiscard]] const sol::object& handle() const noexcept { return self; }
+
+        [[nodiscard]] std::size_t size() const noexcept { return count; }
+
+        /// Get the target at (0-based) `index'
+        [[nodiscard]] EntityLogger& at(std::size_t index) noexcept {
+            return *slots[index];
+        }
+
+        /// Get the target at (1-based) `index', or nil if out of range
+        [[nodiscard]] sol::object get(long index) const {
+            if (index < 1 || static_cast<std::size_t>(index) > count)
+                return sol::make_object(lua(), sol::lua_nil);
+            return handles[static_cast<std::size_t>(index - 1)];
+        }
+
+    private:
+        sol::object self;
+        std::vector<Entity*> resolved;
+        std::vector<std::unique_ptr<EntityLogger>> slots;
+        std::vector<sol::object> handles;
+        std::size_t count = 0;
+    };
+
+    TargetSet& targetSet() {
+        thread_local TargetSet targets;
+        return targets;
+    }
+}
+
+namespace {
+    /// Deal a skill's damage to every one of its targets in one go
+    /// See DamageBatch for the details.
+    void dealDamage(sol::table s, EntityLogger& source, EntityLogger& target,
+                    TargetSet& targets)
+    {
+        const auto attr = [&s](const char* name) {
+            auto val = s[name];
+            if (val.get_type() != sol::type::number)
+                throw std::invalid_argument(
+                    std::string{"deal_damage: skill needs a '"} + name + "'");
+            return static_cast<int>(std::lround(val.get<double>()));
+        };
+
+        DamageSkill skill;
+        skill.power = attr("power");
+        skill.accuracy = attr("accuracy");
+        skill.method = s["method"];
+        skill.spread = s["spread"];
+        skill.element = s["element"];
+
+        thread_local DamageBatch batch;
+        batch.reset(skill, source.getStats());
+        for (std::size_t i = 0; i < targets.size(); i++) {
+            auto& el = targets.at(i);
+            batch.add(*el.entity, el.getStats(), el == target);
+        }
+        batch.resolve();
+        batch.apply(*source.logger);
+    }
+
+    void loadNativeSkillFunctions(sol::state_view& lua) {
+        // `skill' is otherwise created by the lua side; make sure it exists now
+        auto skill = lua["skill"].get_or_create<sol::table>();
+        skill["deal_damage"] = &dealDamage;
+    }
+
+    void loadTargetSetMetatable(sol::state_view& lua) {
+        auto metatable = lua.new_usertype<TargetSet>("target_set",
+            "new", sol::no_constructor);
+
+        // only numeric indexing and `#' make sense; this keeps `for i = 1, #t'
+        // loops working the same regardless of which lua we're built against
+        metatable[sol::meta_function::length] = &TargetSet::size;
+        metatable[sol::meta_function::index] = &TargetSet::get;
+    }
+}
+
+// skill profiling
+namespace {
+
+    struct SkillProfiler {
+        bool enabled = false;
+        std::map<std::pair<std::string, int>, SkillProfile> profiles;
+        SkillProfile* current = nullptr;  ///< the skill being performed
+
+        static void hook(lua_State*, lua_Debug*) {
+            if (auto* p = profiler().current)
+                p->instructions += profile_hook_interval;
+        }
+
+        static SkillProfiler& profiler() {
+            thread_local SkillProfiler p;
+            return p;
+        }
+    };
+
+    std::uint64_t bytesAllocated() {
+#ifdef SOL_LUAJIT
+        // not quite the same thing, as it goes down when garbage is collected
+        lua_State* L = lua();
+        return std::uint64_t(lua_gc(L, LUA_GCCOUNT, 0)) * 1024
+             + std::uint64_t(lua_gc(L, LUA_GCCOUNTB, 0));
+#else
+        return allocator().allocated();
+#endif
+    }
+
+    /// Charges whatever happens during its lifetime to a skill, if profiling
+    class ProfileScope {
+    public:
+        ProfileScope(const std::string& name, int level) {
+            auto& p = SkillProfiler::profiler();
+            if (!p.enabled)
+                return;
+
+            auto key = std::make_pair(name, level);
+            auto it = p.profiles.find(key);
+            if (it == p.profiles.end()) {
+                SkillProfile fresh;
+                fresh.name = name;
+                fresh.level = level;
+                it = p.profiles.emplace(std::move(key), std::move(fresh)).first;
+            }
+
+            profile = &it->second;
+            previous = std::exchange(p.current, profile);
+            bytes = bytesAllocated();
+            start = std::chrono::steady_clock::now();
+        }
+
+        ~ProfileScope() {
+            if (!profile)
+                return;
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            const auto now_bytes = bytesAllocated();
+
+            profile->calls++;
+            profile->nanoseconds.add(static_cast<std::uint64_t>(ns));
+            if (now_bytes > bytes)
+                profile->bytes_allocated += now_bytes - bytes;
+            SkillProfiler::profiler().current = previous;
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        SkillProfile* profile = nullptr;
+        SkillProfile* previous = nullptr;
+        std::uint64_t bytes = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+
+}
+
+namespace battle {
+
+    void setSkillProfiling(bool on) {
+        auto& p = SkillProfiler::profiler();
+        p.enabled = on;
+        lua_State* L = lua();
+        if (on)
+            lua_sethook(L, &SkillProfiler::hook, LUA_MASKCOUNT, profile_hook_interval);
+        else
+            lua_sethook(L, nullptr, 0, 0);
+    }
+
+    std::vector<SkillProfile> takeSkillProfiles() {
+        auto& p = SkillProfiler::profiler();
+        std::vector<SkillProfile> result;
+        for (auto&& [key, profile] : p.profiles)
+            result.push_back(std::move(profile));
+        p.profiles.clear();
+        p.current = nullptr;
+        return result;
+    }
+
+}
+
+// memory and garbage collection
+namespace {
+
+    // bytes allocated as of the last collector step, and the step work owed
+    // on top of that
+    struct CollectorPacing {
+        std::uint64_t last = 0;
+        std::size_t owed_kb = 0;
+    };
+
+    CollectorPacing& pacing() {
+        thread_local CollectorPacing p;
+        return p;
+    }
+
+    std::uint64_t allocatedSoFar() {
+#ifdef SOL_LUAJIT
+        // there's no running total, so go by how far the heap has grown
+        lua_State* L = lua();
+        return std::uint64_t(lua_gc(L, LUA_GCCOUNT, 0)) * 1024;
+#else
+        return allocator().allocated();
+#endif
+    }
+
+}
+
+namespace battle {
+
+    LuaMemory luaMemory() {
+#ifdef SOL_LUAJIT
+        lua_State* L = lua();
+        const auto in_use = std::size_t(lua_gc(L, LUA_GCCOUNT, 0)) * 1024
+                          + std::size_t(lua_gc(L, LUA_GCCOUNTB, 0));
+        return { in_use, 0, 0, 0, 0 };
+#else
+        (void)lua();
+        const auto& a = allocator();
+        return { a.inUse(), a.peak(), a.reserved(), a.getLimit(), a.allocated() };
+#endif
+    }
+
+    void setLuaMemoryLimit([[maybe_unused]] std::size_t bytes) {
+#ifndef SOL_LUAJIT
+        (void)lua();
+        allocator().setLimit(bytes);
+#endif
+    }
+
+    void stepLuaCollector(std::size_t max_kb) {
+        lua_State* L = lua();
+        auto& p = pacing();
+
+        // only whole KiB are owed, but the rest isn't forgotten: a turn
+        // usually allocates less than that, and would otherwise never count
+        const auto now = allocatedSoFar();
+        if (now > p.last) {
+            const auto kb = (now - p.last) / 1024;
+            p.owed_kb += static_cast<std::size_t>(kb);
+            p.last += kb * 1024;
+        } else {
+            p.last = now;  // LuaJIT's heap shrank
+        }
+
+        const auto kb = std::min(p.owed_kb, max_kb);
+        if (kb == 0)
+            return;
+        p.owed_kb -= kb;
+        lua_gc(L, LUA_GCSTEP, static_cast<int>(kb));
+#ifdef SOL_LUAJIT
+        // like Lua 5.1, LuaJIT has no separate `stopped' flag: finishing a
+        // cycle sets a new threshold, and the collector would run by itself
+        // again from there
+        lua_gc(L, LUA_GCSTOP, 0);
+#endif
+    }
+
+    void collectLuaGarbage() {
+        lua_State* L = lua();
+        lua_gc(L, LUA_GCCOLLECT, 0);
+#ifdef SOL_LUAJIT
+        lua_gc(L, LUA_GCSTOP, 0);  // as above, a full collection restarts it
+#endif
+        auto& p = pacing();
+        p.last = allocatedSoFar();
+        p.owed_kb = 0;
+    }
+
 }
 
 // SkillDetails implementation
@@ -363,17 +763,41 @@ namespace battle {
         element = t["element"];
     }
 
+    std::shared_ptr<const SkillDetails>
+    SkillDetails::shared(const std::string& name, int level) {
+        // make sure the lua state is around before the cache, so it's still
+        // there when the cache gets destroyed at thread exit
+        (void)::lua();
+        thread_local std::map<std::pair<std::string, int>,
+                              std::shared_ptr<const SkillDetails>> cache;
+
+        auto key = std::make_pair(name, level);
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+            TRACE_SCOPE("SkillDetails::SkillDetails");
+            auto details = std::make_shared<const SkillDetails>(name, level);
+            it = cache.emplace(std::move(key), std::move(details)).first;
+        }
+        return it->second;
+    }
+
     void SkillDetails::perform(MessageLogger& logger,
             Entity& source, Entity& target,
             BattleSystem& system) const
     {
+        TRACE_SCOPE("SkillDetails::perform");
+        ProfileScope profile{ name, level };
+
         auto log = set_log([&logger](const Message& m) { logger.appendMessage(m); });
 
         ::EntityLogger src{ &source, &system, &logger };
         ::EntityLogger tgt{ &target, &system, &logger };
 
+        auto& targets = targetSet();
+        targets.resolve(spread, source, target, system, logger);
+
         sol::protected_function perform = handle->data["perform"];
-        auto ret = perform(handle->data, src, tgt, log);
+        auto ret = perform(handle->data, src, tgt, targets.handle());
         if (!ret.valid()) {
             sol::error err = ret;
             // TODO: dedicated error type for failures here
@@ -0,0 +1,161 @@
+#include "battle/damage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "battle/entity.h"
+#include "battle/messages.h"
+#include "util/random.h"
+
+namespace battle {
+
+
+std::optional<DamageSkill> damageSkillOf(const SkillDetails& details) noexcept {
+    const auto power = details.getPower();
+    const auto accuracy = details.getAccuracy();
+    if (!power || !accuracy)
+        return std::nullopt;
+
+    DamageSkill skill;
+    skill.power = *power;
+    skill.accuracy = *accuracy;
+    skill.method = details.getMethod();
+    skill.spread = details.getSpread();
+    skill.element = details.getElement();
+    return skill;
+}
+
+double DamageOdds::killChance(int health, double scale) const noexcept {
+    // a hit deals `damage' times a variance drawn from [0.8, 1.2], rounded,
+    // so this is the chance that the variance is high enough
+    const auto beyond = [health](double average) {
+        if (average <= 0)
+            return 0.0;
+        const double needed = (health - 0.5) / average;
+        return std::clamp((1.2 - needed) / 0.4, 0.0, 1.0);
+    };
+    const double normal = damage * scale;
+    return hit * ((1 - crit) * beyond(normal) + crit * beyond(2 * normal));
+}
+
+DamageOdds damageOdds(const DamageSkill& skill, const Stats& source,
+                      const Stats& target, int resist) noexcept
+{
+    int attack = 0, defense = 0;
+    switch (skill.method) {
+    case SkillMethod::Physical:
+        attack = source.p_atk;
+        defense = target.p_def;
+        break;
+    case SkillMethod::Magical:
+        attack = source.m_atk;
+        defense = target.m_def;
+        break;
+    case SkillMethod::Mixed:
+    case SkillMethod::None:
+        return {};
+    }
+
+    // as in DamageBatch::resolve, with the dice swapped for their odds
+    const int hit_chance = skill.accuracy + source.skill - target.evade;
+    const double crit_chance = std::floor(hit_chance / static_cast<double>(skill.crit_difficulty));
+
+    DamageOdds odds;
+    odds.hit = std::clamp(hit_chance, 0, 100) / 100.0;
+    odds.crit = std::clamp(crit_chance, 0.0, 100.0) / 100.0;
+    odds.damage = std::max(skill.power / 100.0 * (4 * attack - 2 * defense), 0.0)
+                * (-resist / 100.0 + 1.0);
+    return odds;
+}
+
+void DamageBatch::reset(const DamageSkill& s, const Stats& source) {
+    switch (s.method) {
+    case SkillMethod::Physical: attack = source.p_atk; break;
+    case SkillMethod::Magical:  attack = source.m_atk; break;
+    case SkillMethod::Mixed:
+    case SkillMethod::None:
+        throw std::invalid_argument(
+            "DamageBatch: skill method must be physical or magical");
+    }
+
+    skill = s;
+    source_skill = source.skill;
+
+    targets.clear();
+    evade.clear();
+    defense.clear();
+    resist.clear();
+    spread_mod.clear();
+}
+
+void DamageBatch::add(Entity& target, const Stats& stats, bool primary) {
+    targets.push_back(&target);
+    evade.push_back(stats.evade);
+    defense.push_back(skill.method == SkillMethod::Physical ? stats.p_def : stats.m_def);
+    resist.push_back(target.getResistance(skill.element));
+    // secondary targets of a semi-AoE skill take 70% damage
+    spread_mod.push_back(skill.spread == SkillSpread::SemiAoE && !primary ? 0.7 : 1.0);
+}
+
+void DamageBatch::resolve() {
+    const auto n = targets.size();
+    hit_chance.resize(n);
+    variance.resize(n);
+    crit_mod.resize(n);
+    results.resize(n);
+    damages.resize(n);
+
+    // percentage chance of scoring a hit on each target
+    const int base_chance = skill.accuracy + source_skill;
+    for (std::size_t i = 0; i < n; i++)
+        hit_chance[i] = base_chance - evade[i];
+
+    // roll the dice; this has to be sequential, in the same order as lua does
+    // it: to hit, then to crit if it hit, then the damage variance
+    const double crit_difficulty = skill.crit_difficulty;
+    for (std::size_t i = 0; i < n; i++) {
+        if (hit_chance[i] < util::random(1L, 100L)) {
+            results[i] = HitResult::Miss;
+            variance[i] = 0.0;
+            crit_mod[i] = 1.0;
+            continue;
+        }
+        const bool crit = hit_chance[i] / crit_difficulty >= util::random(1L, 100L);
+        results[i] = crit ? HitResult::Critical : HitResult::Hit;
+        crit_mod[i] = crit ? 2.0 : 1.0;
+        variance[i] = util::random(0.8, 1.2);
+    }
+
+    // now the actual damage; the order of operations matches skill.raw_damage
+    // and default_perform, so the results are bit-for-bit the same.
+    // a miss has a variance of zero, so deals no damage
+    const double power = skill.power / 100.0;
+    const int attack_mod = 4 * attack;
+    for (std::size_t i = 0; i < n; i++) {
+        const double raw = std::max(
+            variance[i] * power * (attack_mod - 2 * defense[i]), 0.0);
+        const double mod = (-resist[i] / 100.0 + 1.0) * crit_mod[i] * spread_mod[i];
+        damages[i] = mod * raw;
+    }
+}
+
+void DamageBatch::apply(MessageLogger& logger) const {
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        Entity& target = *targets[i];
+        switch (results[i]) {
+        case HitResult::Miss:
+            logger.appendMessage(message::Miss{ target });
+            continue;
+        case HitResult::Critical:
+            logger.appendMessage(message::Critical{ target });
+            break;
+        case HitResult::Hit:
+            break;
+        }
+        target.drain<Pool::Health>(logger, static_cast<int>(std::lround(damages[i])));
+    }
+}
+
+
+}
@@ -0,0 +1,113 @@
+#ifndef BATTLE_DAMAGE_H_INCLUDED
+#define BATTLE_DAMAGE_H_INCLUDED
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include "battle/element.h"
+#include "battle/skilldetails.h"
+#include "battle/stats.h"
+
+namespace battle {
+
+
+class Entity;
+class MessageLogger;
+
+/// The attributes of a skill that matter for dealing damage
+struct DamageSkill {
+    int power;                ///< base damage of the skill
+    int accuracy;             ///< base chance to hit (as a percentage)
+    SkillMethod method;       ///< must be physical or magical
+    SkillSpread spread;       ///< semi-AoE skills go easier on secondary targets
+    Element element;          ///< element to look up resistances for
+    int crit_difficulty = 6;  ///< how hard it is to score a critical hit
+};
+
+/// The damage attributes of a skill, if it has a power and accuracy
+[[nodiscard]] std::optional<DamageSkill> damageSkillOf(const SkillDetails& details) noexcept;
+
+/// How a damaging skill went against one target
+enum class HitResult : unsigned char {
+    Miss,
+    Hit,
+    Critical,
+};
+
+/// The chances of a damaging skill against one defender, before any dice are
+/// rolled; worked out the same way DamageBatch rolls them
+struct DamageOdds {
+    double hit = 0;     ///< chance of hitting at all
+    double crit = 0;    ///< chance of a hit being critical
+    double damage = 0;  ///< average damage of a normal hit, after resistance
+
+    /// The damage to expect on average, counting misses and critical hits
+    [[nodiscard]] double expected() const noexcept {
+        return hit * damage * (1 + crit);
+    }
+
+    /// The chance of doing at least `health' damage in one go, with damage
+    /// scaled by `scale' (e.g. for secondary targets)
+    [[nodiscard]] double killChance(int health, double scale = 1.0) const noexcept;
+};
+
+/// Work out the odds of `skill' used by someone with `source' stats against
+/// someone with `target' stats and `resist' resistance to its element.
+/// Skills that aren't physical or magical have no odds at all.
+[[nodiscard]] DamageOdds damageOdds(const DamageSkill& skill, const Stats& source,
+                                    const Stats& target, int resist) noexcept;
+
+/// Resolves a damaging skill against every one of its targets at once
+///
+/// This is the native equivalent of looping `skill.did_hit`,
+/// `skill.raw_damage` and `skill.resistance` over each target in lua.
+/// Defender stats are gathered into flat arrays up front so the arithmetic
+/// runs as straight-line passes the compiler can vectorise; only the dice
+/// rolls are done one at a time, in the same order the lua version makes
+/// them, so a seeded battle plays out identically either way.
+///
+/// The storage is kept between uses; reuse a batch rather than making a new
+/// one per skill.
+class DamageBatch {
+public:
+    /// Start a new batch for `skill' used by someone with `source' stats
+    void reset(const DamageSkill& skill, const Stats& source);
+
+    /// Add a defender to the batch
+    /// `primary' is whether they are the skill's chosen target.
+    void add(Entity& target, const Stats& stats, bool primary);
+
+    /// Roll to hit and work out the damage for every defender
+    void resolve();
+
+    /// Log the misses and critical hits and deal the damage, in target order
+    void apply(MessageLogger& logger) const;
+
+    [[nodiscard]] std::size_t size() const noexcept { return targets.size(); }
+    [[nodiscard]] HitResult result(std::size_t i) const noexcept { return results[i]; }
+    [[nodiscard]] double damage(std::size_t i) const noexcept { return damages[i]; }
+
+private:
+    DamageSkill skill = {};
+    int attack = 0;       ///< the attacking stat chosen by the skill's method
+    int source_skill = 0; ///< the attacker's hit chance modifier
+
+    // defender info, one entry per target
+    std::vector<Entity*> targets;
+    std::vector<int> evade;
+    std::vector<int> defense;
+    std::vector<int> resist;
+    std::vector<double> spread_mod;
+
+    // working state and results
+    std::vector<int> hit_chance;
+    std::vector<double> variance;
+    std::vector<double> crit_mod;
+    std::vector<HitResult> results;
+    std::vector<double> damages;
+};
+
+
+}
+
+#endif // BATTLE_DAMAGE_H_INCLUDED
@@ -0,0 +1,240 @@
+#include "battle/decisionlog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "battle/entity.h"
+#include "battle/skill.h"
+#include "util/logwriter.h"
+#include "util/overload.h"
+#include "util/trace.h"
+
+namespace battle {
+
+namespace {
+
+    using decisionfile::ActionKind;
+
+    // the nearest IEEE half floats to `count' floats, their bits anyway;
+    // features are all small enough that the lost precision doesn't matter,
+    // and it halves the file. Rounds ties to even, and anything too big (or
+    // not a number) becomes infinity. No branches, so it vectorises
+    void toHalf(const float* in, std::size_t count, std::uint16_t* out) noexcept {
+        constexpr std::uint32_t too_big = (127u + 16) << 23;          // 2^16
+        constexpr std::uint32_t smallest_normal = (127u - 14) << 23;  // 2^-14
+        constexpr std::uint32_t subnormal_magic = (127u - 1) << 23;   // 0.5
+        for (std::size_t i = 0; i < count; i++) {
+            std::uint32_t bits;
+            std::memcpy(&bits, &in[i], sizeof bits);
+            const auto sign = (bits >> 16) & 0x8000;
+            bits &= 0x7fffffff;
+
+            // subnormal (or zero): adding 0.5 lines the mantissa up at the
+            // bottom, and the addition itself does the rounding
+            float shifted, magic;
+            std::memcpy(&shifted, &bits, sizeof shifted);
+            std::memcpy(&magic, &subnormal_magic, sizeof magic);
+            shifted += magic;
+            std::uint32_t small;
+            std::memcpy(&small, &shifted, sizeof small);
+            small -= subnormal_magic;
+
+            // normal: rebias the exponent, and round to even by hand; a carry
+            // rolls into the exponent
+            const auto odd = (bits >> 13) & 1;
+            const auto normal = (bits - ((127u - 15) << 23) + 0xfff + odd) >> 13;
+
+            // picked between with masks, as a branch stops it vectorising
+            const auto is_small = 0u - static_cast<std::uint32_t>(bits < smallest_normal);
+            const auto is_big = 0u - static_cast<std::uint32_t>(bits >= too_big);
+            const auto half = (((small & is_small) | (normal & ~is_small)) & ~is_big)
+                            | (0x7c00u & is_big);
+            out[i] = static_cast<std::uint16_t>(sign | half);
+        }
+    }
+
+    // write the first `count' values of a column, padded out to the next 8
+    // bytes
+    template <typename T>
+    void writeColumn(util::LogBuffer& out, const std::vector<T>& column, std::size_t count) {
+        const auto bytes = count * sizeof(T);
+        out << std::string_view{ reinterpret_cast<const char*>(column.data()), bytes };
+        for (auto pad = bytes; pad % 8 != 0; pad++)
+            out << '\0';
+    }
+
+    template <typename T>
+    std::uint64_t columnSize(std::size_t count) noexcept {
+        return (count * sizeof(T) + 7) / 8 * 8;
+    }
+
+}
+
+void DecisionRecorder::Columns::grow(std::size_t room, std::size_t features_per_row) {
+    features.resize(room * features_per_row);
+    legal.resize(room);
+    action.resize(room);
+    skill.resize(room);
+    target.resize(room);
+    outcome.resize(room);
+    battle.resize(room);
+    team.resize(room);
+    actor.resize(room);
+    decision.resize(room);
+    capacity = room;
+}
+
+DecisionRecorder::DecisionRecorder(util::LogBuffer& out, std::size_t targets,
+                                   std::size_t skills, std::size_t batch_rows)
+    : out{ out }
+    , num_targets{ targets }
+    , num_skills{ skills }
+    , num_features{ PolicyNetwork::entity_features * (1 + targets)
+                    + PolicyNetwork::skill_features * skills }
+    , batch_rows{ std::max<std::size_t>(batch_rows, 1) }
+{
+    if (skills + 1 + targets > 16)
+        throw std::invalid_argument("DecisionRecorder: too many slots for the legal mask");
+    if (skills >= decisionfile::none || targets >= decisionfile::none)
+        throw std::invalid_argument("DecisionRecorder: too many slots");
+
+    // a battle's rows usually take a batch a little past `batch_rows'
+    batch.grow(this->batch_rows + this->batch_rows / 4, num_features);
+}
+
+DecisionRecorder::~DecisionRecorder() {
+    flush();
+}
+
+void DecisionRecorder::endBattle(const Team* winner) {
+    TRACE_SCOPE("DecisionRecorder::endBattle");
+    for (auto row = battle_start; row < batch.rows; row++) {
+        const auto team = static_cast<Team>(batch.team[row]);
+        batch.outcome[row] = static_cast<std::int8_t>(!winner ? 0 : *winner == team ? 1 : -1);
+    }
+    battle_start = batch.rows;
+
+    if (batch.rows >= batch_rows)
+        flush();
+}
+
+void DecisionRecorder::flush() {
+    const auto rows = batch.rows;
+    if (rows == 0)
+        return;
+    TRACE_SCOPE("DecisionRecorder::flush");
+
+    decisionfile::BatchHeader header{};
+    std::memcpy(header.magic, decisionfile::magic, sizeof header.magic);
+    header.version = decisionfile::version;
+    header.rows = static_cast<std::uint32_t>(rows);
+    header.features = static_cast<std::uint32_t>(num_features);
+    header.skills = static_cast<std::uint32_t>(num_skills);
+    header.targets = static_cast<std::uint32_t>(num_targets);
+    header.size = (sizeof header + 7) / 8 * 8
+        + columnSize<std::uint16_t>(rows * num_features) + columnSize<std::uint16_t>(rows)
+        + columnSize<std::uint8_t>(rows) + columnSize<std::uint8_t>(rows)
+        + columnSize<std::uint8_t>(rows) + columnSize<std::int8_t>(rows)
+        + columnSize<std::uint32_t>(rows) + columnSize<std::uint8_t>(rows)
+        + columnSize<std::uint8_t>(rows) + columnSize<std::uint16_t>(rows);
+
+    out << std::string_view{ reinterpret_cast<const char*>(&header), sizeof header };
+    writeColumn(out, batch.features, rows * num_features);
+    writeColumn(out, batch.legal, rows);
+    writeColumn(out, batch.action, rows);
+    writeColumn(out, batch.skill, rows);
+    writeColumn(out, batch.target, rows);
+    writeColumn(out, batch.outcome, rows);
+    writeColumn(out, batch.battle, rows);
+    writeColumn(out, batch.team, rows);
+    writeColumn(out, batch.actor, rows);
+    writeColumn(out, batch.decision, rows);
+    out.commit();
+
+    batch.rows = 0;
+    battle_start = 0;
+}
+
+void DecisionRecorder::record(RecordingController& c, const PolicyFeatures& seen,
+                              const Action& act)
+{
+    const auto& usable = seen.usable();
+    const auto& slots = seen.targets();
+    std::uint16_t legal = static_cast<std::uint16_t>(1u << num_skills);
+    for (std::size_t i = 0; i < usable.size(); i++)
+        if (usable[i])
+            legal = static_cast<std::uint16_t>(legal | 1u << i);
+    for (std::size_t j = 0; j < slots.size(); j++)
+        legal = static_cast<std::uint16_t>(legal | 1u << (num_skills + 1 + j));
+
+    auto kind = ActionKind::Defend;
+    auto skill = decisionfile::none;
+    auto target = decisionfile::none;
+    std::visit(util::overload{
+        [&](const action::Defend&) { kind = ActionKind::Defend; },
+        [&](const action::Flee&) { kind = ActionKind::Flee; },
+        [&](const action::UserChoice&) { kind = ActionKind::UserChoice; },
+        [&](const action::Skill& s) {
+            kind = ActionKind::Skill;
+            const auto skills = c.entity.getUsableSkills();
+            for (std::size_t i = 0; i < std::min(skills.total(), num_skills); i++)
+                if (skills[i] == s.skill)
+                    skill = static_cast<std::uint8_t>(i);
+            for (std::size_t j = 0; j < slots.size(); j++)
+                if (slots[j] == &s.target)
+                    target = static_cast<std::uint8_t>(j);
+        },
+    }, act);
+
+    std::lock_guard lock{ mutex };
+    if (batch.rows == batch.capacity)
+        batch.grow(batch.capacity * 2, num_features);
+    const auto row = batch.rows++;
+
+    toHalf(seen.values().data(), num_features, &batch.features[row * num_features]);
+    batch.legal[row] = legal;
+    batch.action[row] = static_cast<std::uint8_t>(kind);
+    batch.skill[row] = skill;
+    batch.target[row] = target;
+    batch.outcome[row] = 0;
+    batch.battle[row] = battle;
+    batch.team[row] = static_cast<std::uint8_t>(c.team);
+    batch.actor[row] = c.actor;
+    batch.decision[row] = c.decisions++;
+}
+
+
+RecordingController::RecordingController(Entity& entity, std::unique_ptr<Controller> inner,
+                                         DecisionRecorder& recorder, Team team,
+                                         std::uint8_t actor)
+    : entity{ entity }
+    , inner{ std::move(inner) }
+    , recorder{ recorder }
+    , team{ team }
+    , actor{ actor }
+    , features{ recorder.targets(), recorder.skills() }
+{
+    // a policy network works out the very same features; no need to twice
+    const auto* p = dynamic_cast<const PolicyController*>(this->inner.get());
+    if (p && p->lastFeatures().targetSlots() == recorder.targets()
+          && p->lastFeatures().skillSlots() == recorder.skills())
+        policy = p;
+}
+
+Action RecordingController::go(const BattleView& view) {
+    TRACE_SCOPE("RecordingController::go");
+    Action act = inner->go(view);
+    if (policy) {
+        recorder.record(*this, policy->lastFeatures(), act);
+    } else {
+        features.encode(entity, view);
+        recorder.record(*this, features, act);
+    }
+    return act;
+}
+
+}
@@ -0,0 +1,170 @@
+#ifndef BATTLE_DECISIONLOG_H_INCLUDED
+#define BATTLE_DECISIONLOG_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "battle/combatantstore.h"
+#include "battle/controller.h"
+#include "battle/policycontroller.h"
+
+namespace util { class LogBuffer; }
+
+namespace battle {
+
+class Entity;
+class RecordingController;
+
+/// The layout of a decision file, as written by DecisionRecorder
+///
+/// A file is a run of batches, one after another. Each batch starts with a
+/// BatchHeader, followed by one column after another, in this order:
+///
+///     features  float16[rows][features]   see PolicyFeatures
+///     legal     uint16[rows]   bit i: skill slot i usable; bit `skills':
+///                              defending (always); bit `skills' + 1 + j:
+///                              target slot j filled
+///     action    uint8[rows]    an ActionKind
+///     skill     uint8[rows]    skill slot used, or `none'
+///     target    uint8[rows]    target slot aimed at, or `none' (e.g. when
+///                              it was the user, or someone past the slots)
+///     outcome   int8[rows]     1 if the decider's team won, -1 if it lost,
+///                              0 if the battle ran out of turns
+///     battle    uint32[rows]   which battle (numbered as in battle-sim)
+///     team      uint8[rows]    the decider's Team
+///     actor     uint8[rows]    the decider's place in their team
+///     decision  uint16[rows]   how many decisions the decider made before
+///
+/// Every column starts on an 8-byte boundary (padding with zeroes), and
+/// everything is in the writing machine's byte order (little-endian, for
+/// anything we build on), so a mapped file can be used as is: numpy's
+/// `frombuffer' on each column, say. Rows are in the order the decisions
+/// were made, except that within a phase (in phase mode) they're in
+/// whatever order the threads got to them; `decision' gives each decider's.
+namespace decisionfile {
+    inline constexpr char magic[8] = { 'T', 'B', 'D', 'E', 'C', 'I', 'D', 'E' };
+    inline constexpr std::uint32_t version = 1;
+    inline constexpr std::uint8_t none = 0xff;
+
+    enum class ActionKind : std::uint8_t { Defend, Skill, Flee, UserChoice };
+
+    struct BatchHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t rows;
+        std::uint32_t features;      ///< per row
+        std::uint32_t skills;        ///< skill slots
+        std::uint32_t targets;       ///< target slots
+        std::uint32_t reserved;
+        std::uint64_t size;          ///< of the whole batch, header and all
+    };
+    static_assert(sizeof(BatchHeader) == 40);
+}
+
+/// Collects what recording controllers decided, and writes it out in batches
+///
+/// Each decision goes straight into the batch's columns, which have room
+/// for a batch's worth of rows from the start; `endBattle' then fills in the
+/// battle's outcome. Deciding in phase mode happens on several threads, so
+/// adding a row takes a lock, but nobody else should be waiting on it. Give
+/// each battle thread a recorder of its own, writing to a LogBuffer of its
+/// own; batches are committed whole, so they never interleave in the file.
+class DecisionRecorder {
+public:
+    static constexpr std::size_t default_batch_rows = 4096;
+
+    /// `targets' and `skills' are the number of slots in the features
+    DecisionRecorder(util::LogBuffer& out, std::size_t targets = 4, std::size_t skills = 4,
+                     std::size_t batch_rows = default_batch_rows);
+
+    /// Writes out whatever's left
+    ~DecisionRecorder();
+
+    DecisionRecorder(const DecisionRecorder&) = delete;
+    DecisionRecorder& operator=(const DecisionRecorder&) = delete;
+
+    /// Start recording a new battle, numbered `battle'
+    void beginBattle(std::uint32_t battle) noexcept {
+        this->battle = battle;
+        battle_start = batch.rows;
+    }
+
+    /// Collect the current battle's decisions; `winner' is nullptr for a draw
+    void endBattle(const Team* winner);
+
+    /// Write out the rows collected so far, full batch or not
+    void flush();
+
+    [[nodiscard]] std::size_t targets() const noexcept { return num_targets; }
+    [[nodiscard]] std::size_t skills() const noexcept { return num_skills; }
+
+private:
+    friend class RecordingController;
+
+    /// Add a row for what `c' decided, given `seen'
+    void record(RecordingController& c, const PolicyFeatures& seen, const Action& act);
+
+    /// The columns of a batch, each with room for `capacity' rows, of which
+    /// the first `rows' are filled in
+    struct Columns {
+        std::vector<std::uint16_t> features;  ///< as IEEE half floats
+        std::vector<std::uint16_t> legal;
+        std::vector<std::uint8_t> action;
+        std::vector<std::uint8_t> skill;
+        std::vector<std::uint8_t> target;
+        std::vector<std::int8_t> outcome;
+        std::vector<std::uint32_t> battle;
+        std::vector<std::uint8_t> team;
+        std::vector<std::uint8_t> actor;
+        std::vector<std::uint16_t> decision;
+
+        std::size_t rows = 0;
+        std::size_t capacity = 0;
+
+        /// Make room for `room' rows in all
+        void grow(std::size_t room, std::size_t features_per_row);
+    };
+
+    util::LogBuffer& out;
+    std::size_t num_targets;
+    std::size_t num_skills;
+    std::size_t num_features;  ///< per row
+    std::size_t batch_rows;
+    std::uint32_t battle = 0;
+    std::size_t battle_start = 0;  ///< the current battle's first row
+
+    std::mutex mutex;  ///< for adding rows
+    Columns batch;
+};
+
+/// Wraps another controller, recording every decision it makes
+class RecordingController : public Controller {
+public:
+    static constexpr bool nest_controller = true;
+
+    /// `actor' is the entity's place in `team'
+    RecordingController(Entity& entity, std::unique_ptr<Controller> inner,
+                        DecisionRecorder& recorder, Team team, std::uint8_t actor);
+
+    [[nodiscard]] virtual Action go(const BattleView& view) override;
+
+private:
+    friend class DecisionRecorder;
+
+    Entity& entity; ///< the owning entity
+    std::unique_ptr<Controller> inner;
+    DecisionRecorder& recorder;
+    Team team;
+    std::uint8_t actor;
+    std::uint16_t decisions = 0;  ///< made so far
+
+    /// `inner', if it's a policy network that sees what's recorded anyway
+    const PolicyController* policy = nullptr;
+    PolicyFeatures features;  ///< otherwise, worked out here
+};
+
+}
+
+#endif // BATTLE_DECISIONLOG_H_INCLUDED
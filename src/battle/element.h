@@ -1,8 +1,10 @@
 #ifndef BATTLE_ELEMENT_H_INCLUDED
 #define BATTLE_ELEMENT_H_INCLUDED
 
+#include <array>
 #include <tuple>
 #include <optional>
+#include <string_view>
 
 namespace battle {
 
@@ -34,6 +36,18 @@ enum class Element {
 
 inline constexpr unsigned num_elements = static_cast<unsigned>(Element::_count);
 
+/// The name the element goes by in skill files
+[[nodiscard]] constexpr std::string_view elementName(Element e) noexcept {
+    constexpr std::string_view names[] = {
+        "neutral",
+        "fire", "water", "earth", "air", "light", "dark",
+        "ice", "lightning", "sand", "steam", "life", "metal",
+    };
+    static_assert(std::size(names) == num_elements);
+    const auto i = static_cast<unsigned>(e);
+    return i < num_elements ? names[i] : "unknown";
+}
+
 [[nodiscard]] constexpr bool isPrimaryElement(Element e) noexcept {
     return e == Element::Fire
         || e == Element::Water
@@ -73,6 +87,23 @@ inline constexpr unsigned num_elements = static_cast<unsigned>(Element::_count);
     return std::nullopt;
 }
 
+/// How much resistance to each element counts against a hit of another, as a
+/// percentage: `element_interactions[hit][resist]'. Every element counts in
+/// full against itself, and a secondary element also brings in half of the
+/// resistance to each of its constituents (e.g. Ice is resisted by Ice, and
+/// half as much by each of Water and Air).
+inline constexpr auto element_interactions = [] {
+    std::array<std::array<int, num_elements>, num_elements> table = {};
+    for (unsigned e = 0; e < num_elements; e++) {
+        table[e][e] = 100;
+        if (const auto parts = constituentElements(static_cast<Element>(e))) {
+            table[e][static_cast<unsigned>(std::get<0>(*parts))] += 50;
+            table[e][static_cast<unsigned>(std::get<1>(*parts))] += 50;
+        }
+    }
+    return table;
+}();
+
 
 } // namespace battle
 
@@ -1,9 +1,12 @@
 #include "battle/entity.h"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <iterator>
 #include "battle/controller.h"
 #include "battle/messages.h"
+#include "util/trace.h"
 
 
 namespace battle {
@@ -25,18 +28,30 @@ struct NullController : public Controller {
 };
 
 
+// revisions (of stats and of usable skills) are handed out from one counter,
+// so that no two entities (even one long gone and another made in its place)
+// share one
+static std::uint32_t nextRevision() noexcept {
+    static std::atomic<std::uint32_t> next{ 0 };
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+
 Entity::Entity(EntityID id, int level, Stats stats, std::vector<Skill>&& skills)
     : id { std::move(id) }
     , level{ level }
     , exp_to_next{ 0 }
     , stats{ stats }
-    , health{ this->stats.max_health }
-    , mana{ this->stats.max_mana }
-    , tech{ this->stats.max_tech }
-    , effects{ }
+    , stats_revision{ nextRevision() }
+    , own_pools{ this->stats.max_health, this->stats.max_mana, this->stats.max_tech }
+    , own_effects{ }
     , skills{ std::move(skills) }
+    , usable_skills( this->skills.size(), false )
+    , num_usable_skills{ 0 }
+    , usable_revision{ nextRevision() }
     , controller{ std::make_unique<NullController>() }
 {
+    refreshUsableSkills();
 }
 
 Entity::~Entity() = default;
@@ -47,49 +62,135 @@ void Entity::restoreController(std::unique_ptr<Controller>&& ctrl) noexcept {
 
 std::vector<SkillRef> Entity::getSkills() const {
     // TODO: apply equipment bonuses, status effects, etc.
-    std::vector<SkillRef> refs;
-    std::copy_if(std::begin(skills), std::end(skills),
-                 std::back_inserter(refs),
-                 [this](const Skill& s) { return s.isUsableBy(*this); });
-    return refs;
+    const auto range = getUsableSkills();
+    return { std::begin(range), std::end(range) };
 }
 
-Stats Entity::getStats() const noexcept {
-    // TODO: apply equipment bonuses, etc.
-    // TODO: cache results?
-    std::vector<StatModifier> mods;
-    for (auto&& e : effects) {
-        const auto& effect_mods = e.getMods();
-        std::copy(std::begin(effect_mods), std::end(effect_mods),
-                  std::back_inserter(mods));
+void Entity::addSkill(Skill&& skill) {
+    skills.push_back(std::move(skill));
+    usable_skills.push_back(false);
+    refreshUsableSkills();
+}
+
+void Entity::refreshUsableSkills() noexcept {
+    bool changed = false;
+    num_usable_skills = 0;
+    for (std::size_t i = 0; i < skills.size(); i++) {
+        const bool usable = skills[i].isUsableBy(*this);
+        changed |= usable_skills[i] != usable;
+        usable_skills[i] = usable;
+        num_usable_skills += usable;
     }
+    if (changed)
+        usable_revision = nextRevision();
+}
+
+Stats Entity::getStats() const noexcept {
+    TRACE_SCOPE("Entity::getStats");
 
-    return calculateModifiedStats(stats, mods);
+    // in a battle, the store keeps them cached until the effects change
+    if (store)
+        return store->effectiveStats(handle);
+    return computeStats();
+}
+
+const Stats& Entity::getStats(Stats& scratch) const noexcept {
+    TRACE_SCOPE("Entity::getStats");
+
+    if (store)
+        return store->effectiveStats(handle);
+    scratch = computeStats();
+    return scratch;
+}
+
+int Entity::getResistance(Element e) const noexcept {
+    const auto i = static_cast<std::size_t>(e);
+    if (store)
+        return store->resistances(handle)[i];
+    return effectiveResistances(computeStats())[i];
+}
+
+Stats Entity::computeStats() const noexcept {
+    // TODO: apply equipment bonuses, etc.
+    return applyModifierSums(stats, mod_sums);
 }
 
 // TODO: cap/mod hp/mp/tp as appropriate
 void Entity::applyStatusEffect(MessageLogger& logger, StatusEffect s) {
     logger.appendMessage(message::StatusEffect{ *this, s.getName(), true });
+    for (const auto& m : s.getMods())
+        mod_sums.add(m);
+
+    auto& effects = effectsRef();
+    if (s.getEffectDuration() == EffectDuration::Temporary) {
+        // TODO parse logger and don't count the turn the effect was applied
+        // in (should make more natural durations for effects)
+        s.expiry = turns_ended + static_cast<std::uint32_t>(s.num_turns);
+        const auto due = std::max(s.expiry, turns_ended + 1);
+        expiries[due % expiry_slots].push_back(
+            { due, static_cast<std::uint32_t>(effects.size()) });
+    }
     effects.emplace_back(std::move(s));
+    statsChanged();
+}
+
+std::optional<int> Entity::getRemainingTurns(const StatusEffect& s) const noexcept {
+    if (s.getEffectDuration() != EffectDuration::Temporary)
+        return std::nullopt;
+    return static_cast<int>(s.expiry - turns_ended);
 }
 
 // TODO: cap/mod hp/mp/tp as appropriate
 void Entity::processTurnEnd(MessageLogger& logger) noexcept {
-    // move effects being removed to the end
-    auto it = std::partition(std::begin(effects), std::end(effects), [](auto&& e) {
-        // TODO parse logger and don't call end turn on the effect if the effect
-        // was just applied (should make more natural durations for effects)
-        e.endTurn();
-        return e.isActive();
-    });
-    // process effects being removed
-    std::for_each(it, std::end(effects), [&](auto&& e) {
+    auto& effects = effectsRef();
+    const auto now = ++turns_ended;
+
+    // pick out what's due now; anything else in the slot is due a lap later
+    auto& slot = expiries[now % expiry_slots];
+    wearing_off.clear();
+    std::size_t kept = 0;
+    for (const auto& x : slot) {
+        if (x.turn == now)
+            wearing_off.push_back(x.effect);
+        else
+            slot[kept++] = x;
+    }
+    slot.resize(kept);
+    if (wearing_off.empty())
+        return;
+
+    // process effects being removed, in the order they were applied
+    for (auto i : wearing_off) {
+        for (const auto& m : effects[i].getMods())
+            mod_sums.remove(m);
         logger.appendMessage(message::StatusEffect{
-            *this, e.getName(), false
+            *this, effects[i].getName(), false
         });
-    });
-    // remove effects being, uh, removed
-    effects.erase(it, std::end(effects));
+    }
+
+    // remove effects being, uh, removed: the last effect fills each gap, going
+    // from the back so that it's never one that's about to go itself
+    std::sort(std::begin(wearing_off), std::end(wearing_off), std::greater<>{});
+    for (auto i : wearing_off) {
+        const auto last = static_cast<std::uint32_t>(effects.size() - 1);
+        if (i != last) {
+            effects[i] = std::move(effects[last]);
+            if (effects[i].getEffectDuration() == EffectDuration::Temporary) {
+                const auto due = std::max(effects[i].expiry, now + 1);
+                for (auto& x : expiries[due % expiry_slots])
+                    if (x.effect == last)
+                        x.effect = i;
+            }
+        }
+        effects.pop_back();
+    }
+    statsChanged();
+}
+
+void Entity::statsChanged() noexcept {
+    stats_revision = nextRevision();
+    if (store)
+        store->invalidateStats(handle);
 }
 
 
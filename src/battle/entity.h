@@ -1,16 +1,22 @@
 #ifndef BATTLE_ENTITY_H_INCLUDED
 #define BATTLE_ENTITY_H_INCLUDED
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "battle/combatantstore.h"
 #include "battle/messages.h"
 #include "battle/skill.h"
 #include "battle/skillref.h"
 #include "battle/stats.h"
 #include "battle/statuseffect.h"
+#include "util/symbol.h"
 
 namespace battle {
 
@@ -21,11 +27,11 @@ class Controller;
 ///
 /// `kind` and `type` are enough to determine the stats for an entity uniquely,
 /// and as such the equality comparison for this class does not take `name`
-/// into account.
+/// into account. They're interned, so comparing them is just comparing ids.
 struct EntityID {
-    std::string kind; ///< the 'class' of entity; top level specifier
-    std::string type; ///< the 'species' of entity; bottom level specifier
-    std::string name; ///< a unique descriptor for the particular entity
+    util::Symbol kind; ///< the 'class' of entity; top level specifier
+    util::Symbol type; ///< the 'species' of entity; bottom level specifier
+    std::string name;  ///< a unique descriptor for the particular entity
 
     friend bool operator==(const EntityID& lhs, const EntityID& rhs) noexcept {
         return lhs.kind == rhs.kind && lhs.type == rhs.type;
@@ -35,6 +41,95 @@ struct EntityID {
     }
 };
 
+/// A non-allocating view over the skills an entity can currently use
+///
+/// Walks the entity's skill list, skipping those that are masked off as
+/// unusable. The view is invalidated by anything that changes the entity's
+/// pools, so don't hold onto it past the current decision.
+class UsableSkillRange {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = SkillRef;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = SkillRef;
+
+        SkillRef operator*() const noexcept { return (*skills)[index]; }
+
+        /// Where the skill is in the entity's full list (as in `getSkills')
+        [[nodiscard]] std::size_t position() const noexcept { return index; }
+
+        iterator& operator++() noexcept {
+            index++;
+            skip();
+            return *this;
+        }
+        iterator operator++(int) noexcept {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
+            return lhs.index == rhs.index;
+        }
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) noexcept {
+            return !(lhs == rhs);
+        }
+
+    private:
+        friend class UsableSkillRange;
+
+        iterator(const std::vector<Skill>& skills,
+                 const std::vector<bool>& usable,
+                 std::size_t index) noexcept
+            : skills{ &skills }, usable{ &usable }, index{ index }
+        {
+            skip();
+        }
+
+        // move forward to the next usable skill (or the end)
+        void skip() noexcept {
+            while (index < usable->size() && !(*usable)[index])
+                index++;
+        }
+
+        const std::vector<Skill>* skills;
+        const std::vector<bool>* usable;
+        std::size_t index;
+    };
+
+    UsableSkillRange(const std::vector<Skill>& skills,
+                     const std::vector<bool>& usable,
+                     std::size_t count) noexcept
+        : skills{ skills }, usable{ usable }, count{ count }
+    {}
+
+    [[nodiscard]] iterator begin() const noexcept {
+        return { skills, usable, 0 };
+    }
+    [[nodiscard]] iterator end() const noexcept {
+        return { skills, usable, usable.size() };
+    }
+
+    /// The number of usable skills
+    [[nodiscard]] std::size_t size() const noexcept { return count; }
+
+    /// The number of skills known, usable or not
+    [[nodiscard]] std::size_t total() const noexcept { return usable.size(); }
+
+    /// Any known skill by position, usable or not
+    [[nodiscard]] SkillRef operator[](std::size_t i) const noexcept { return skills[i]; }
+    [[nodiscard]] bool empty() const noexcept { return count == 0; }
+
+private:
+    const std::vector<Skill>& skills;
+    const std::vector<bool>& usable;
+    std::size_t count;
+};
+
 /// An entity in the battle system, player or NPC
 class Entity {
 public:
@@ -92,6 +187,21 @@ public:
     /// \TODO Return a proxy instead, for efficiency? (premature optimization much)
     [[nodiscard]] Stats getStats() const noexcept;
 
+    /// As above, without copying them when they're already cached (in a
+    /// battle); otherwise they're worked out into `scratch'
+    [[nodiscard]] const Stats& getStats(Stats& scratch) const noexcept;
+
+    /// Changes whenever something changes what `getStats' gives, so anything
+    /// worked out from the stats can tell when it needs doing again; never the
+    /// same for two different entities
+    [[nodiscard]] std::uint32_t getStatsRevision() const noexcept {
+        return stats_revision;
+    }
+
+    /// Overall resistance to a hit of the given element, as a percentage,
+    /// counting secondary elements' constituents (see `effectiveResistances')
+    [[nodiscard]] int getResistance(Element e) const noexcept;
+
     /// Get the remaining amount of the specified pool
     template <Pool pool>
     [[nodiscard]] auto get() const noexcept {
@@ -118,6 +228,7 @@ public:
         auto old = p;
         p -= std::max(amt, 0);
         if (p < 0) p = 0;
+        if (p != old) refreshUsableSkills();
         logger.appendMessage(message::PoolChanged{ *this, pool, old, p });
         if constexpr (pool == Pool::Health)
             if (p == 0) logger.appendMessage(message::Died{ *this });
@@ -133,50 +244,93 @@ public:
         const auto s = getMax<pool>();
         p += std::max(amt, 0);
         if (p > s) p = s;
+        if (p != old) refreshUsableSkills();
         logger.appendMessage(message::PoolChanged{ *this, pool, old, p });
     }
 
     /// Retrieve the entity's skills after any modifiers have been applied
     [[nodiscard]] std::vector<SkillRef> getSkills() const;
 
+    /// Iterate over the currently usable skills without allocating
+    [[nodiscard]] UsableSkillRange getUsableSkills() const noexcept {
+        return { skills, usable_skills, num_usable_skills };
+    }
+
+    /// Changes whenever which skills `getUsableSkills' gives does (not on
+    /// every change to the pools); like the stats revision, never the same
+    /// for two different entities
+    [[nodiscard]] std::uint32_t getUsableSkillsRevision() const noexcept {
+        return usable_revision;
+    }
+
+    /// Teach the entity a new skill
+    void addSkill(Skill&& skill);
+
     /// Applies a status effect as part of the base stats
     /// TODO: provide some diff about how stats changed?
     void applyStatusEffect(MessageLogger& logger, StatusEffect s);
 
     /// Get the status effects currently afflicting the entity
-    [[nodiscard]] const auto& getAppliedStatusEffects() const noexcept {
-        return effects;
+    [[nodiscard]] const std::vector<StatusEffect>& getAppliedStatusEffects() const noexcept {
+        return store ? store->effects[handle] : own_effects;
     }
 
+    /// Get the number of turns left for one of the entity's status effects,
+    /// if applicable (see StatusEffect::getEffectDuration)
+    [[nodiscard]] std::optional<int> getRemainingTurns(const StatusEffect& s) const noexcept;
+
     [[nodiscard]] bool isDead() const noexcept {
-        return health <= 0;
+        return getPools().health <= 0;
+    }
+
+    /// Get all of the entity's remaining pools at once
+    [[nodiscard]] const Pools& getPools() const noexcept {
+        return store ? store->pools[handle] : own_pools;
     }
 
     /// Handle any processes that happen after the entity's turn.
     /// For example: buffs wearing off, poison damage, regen effects, etc.
+    /// Only the effects wearing off are looked at, however many there are.
     void processTurnEnd(MessageLogger& logger) noexcept;
 
 private:
+    friend class CombatantStore;
+
     template <Pool pool>
     constexpr auto& getPoolRef() noexcept {
+        auto& p = store ? store->pools[handle] : own_pools;
         if constexpr (pool == Pool::Health)
-            return health;
+            return p.health;
         else if constexpr (pool == Pool::Mana)
-            return mana;
+            return p.mana;
         else if constexpr (pool == Pool::Tech)
-            return tech;
+            return p.tech;
     }
 
     template <Pool pool>
     constexpr const auto& getPoolRef() const noexcept {
+        const auto& p = getPools();
         if constexpr (pool == Pool::Health)
-            return health;
+            return p.health;
         else if constexpr (pool == Pool::Mana)
-            return mana;
+            return p.mana;
         else if constexpr (pool == Pool::Tech)
-            return tech;
+            return p.tech;
     }
 
+    std::vector<StatusEffect>& effectsRef() noexcept {
+        return store ? store->effects[handle] : own_effects;
+    }
+
+    /// Work out the stats with every modifier applied, from `mod_sums'
+    [[nodiscard]] Stats computeStats() const noexcept;
+
+    /// Recompute which skills are usable; call whenever a pool changes
+    void refreshUsableSkills() noexcept;
+
+    /// Call whenever something changes what `getStats' should give
+    void statsChanged() noexcept;
+
     /// What kind of entity this is
     EntityID id;
 
@@ -186,18 +340,44 @@ private:
 
     /// The stats for the entity
     Stats stats;
-
-    // current stats
-    int health;  ///< remaining health
-    int mana;    ///< remaining magic
-    int tech;    ///< remaining tech
-
-    /// Status effects
-    std::vector<StatusEffect> effects;
+    std::uint32_t stats_revision = 0;
+
+    /// The status effects' modifiers, summed up; kept in step with the
+    /// effects as they're applied and wear off
+    ModifierSums mod_sums;
+
+    /// When the temporary effects wear off: a timing wheel, with each effect
+    /// (by its place in the list) in the slot for the turn it's due on, so a
+    /// turn end only looks in the one slot. Effects lasting longer than a lap
+    /// wait in their slot until the wheel comes round to the right turn.
+    struct Expiry {
+        std::uint32_t turn;    ///< when it's due, as a count of turns ended
+        std::uint32_t effect;  ///< which effect
+    };
+    static constexpr std::size_t expiry_slots = 8;
+    std::array<std::vector<Expiry>, expiry_slots> expiries;
+    std::uint32_t turns_ended = 0;
+    std::vector<std::uint32_t> wearing_off;  ///< scratch, for processTurnEnd
+
+    // while the entity is in a battle, its pools and effects are kept in the
+    // battle's store instead of here (see CombatantStore)
+    CombatantStore* store = nullptr;
+    CombatantHandle handle = 0;
+
+    /// Remaining pools, when not in a store
+    Pools own_pools;
+
+    /// Status effects, when not in a store
+    std::vector<StatusEffect> own_effects;
 
     /// The skill the entity itself owns
     std::vector<Skill> skills;
 
+    /// Which of `skills` can currently be paid for; kept in sync with the pools
+    std::vector<bool> usable_skills;
+    std::size_t num_usable_skills;
+    std::uint32_t usable_revision = 0;
+
     /// The current controller for the entity.
     /// Never `nullptr`.
     std::unique_ptr<Controller> controller;
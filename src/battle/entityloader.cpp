@@ -0,0 +1,86 @@
+#include "battle/entityloader.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace battle {
+
+
+std::string entityPath(const std::string& kind, const std::string& type) {
+    return "./data/entity/" + kind + "." + type + ".entity";
+}
+
+int* findBaseStat(Stats& stats, std::string_view name) noexcept {
+    if (name == "max_health") return &stats.max_health;
+    if (name == "max_mana") return &stats.max_mana;
+    if (name == "max_tech") return &stats.max_tech;
+    if (name == "p_atk") return &stats.p_atk;
+    if (name == "p_def") return &stats.p_def;
+    if (name == "m_atk") return &stats.m_atk;
+    if (name == "m_def") return &stats.m_def;
+    if (name == "skill") return &stats.skill;
+    if (name == "evade") return &stats.evade;
+    if (name == "react") return &stats.react;
+    return nullptr;
+}
+
+EntityTemplate loadEntityTemplate(const std::string& kind, const std::string& type) {
+    std::string path = entityPath(kind, type);
+    std::ifstream in { path };
+    if (!in) throw std::invalid_argument("couldn't open '" + path + "'.");
+
+    EntityTemplate t{};
+    Stats& stats = t.stats;
+    t.kind = util::Symbol{ kind };
+    t.type = util::Symbol{ type };
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+
+        std::istringstream iss{ line };
+        std::string stat;
+        iss >> stat;
+
+        if (stat.empty() || stat[0] == '#') continue; // ignore comments
+        else if (auto* p = findBaseStat(stats, stat)) iss >> *p;
+        else if (stat == "ability") {
+            std::string skill_name;
+            std::getline(iss >> std::ws, skill_name);
+            t.skills.push_back(std::move(skill_name));
+        } else
+            throw std::invalid_argument(path + ": unknown key '" + stat + "'.");
+    }
+
+    auto test_stat = [](auto stat, std::string name) {
+        if (stat <= 0)
+            throw std::invalid_argument("bad value for '" + name + "'.");
+    };
+    test_stat(stats.max_health, "max_health");
+    test_stat(stats.max_mana, "max_mana");
+    test_stat(stats.max_tech, "max_tech");
+    test_stat(stats.p_atk, "p_atk");
+    test_stat(stats.p_def, "p_def");
+    test_stat(stats.m_atk, "m_atk");
+    test_stat(stats.m_def, "m_def");
+    test_stat(stats.skill, "skill");
+    test_stat(stats.evade, "evade");
+    test_stat(stats.react, "react");
+
+    return t;
+}
+
+std::shared_ptr<Entity> loadEntity(EntityID id) {
+    const auto t = loadEntityTemplate(id.kind.str(), id.type.str());
+
+    std::vector<Skill> skills;
+    for (const auto& name : t.skills)
+        skills.emplace_back(name);
+
+    return std::make_shared<Entity>(std::move(id), 1, t.stats, std::move(skills));
+}
+
+
+}
@@ -0,0 +1,41 @@
+#ifndef BATTLE_ENTITYLOADER_H_INCLUDED
+#define BATTLE_ENTITYLOADER_H_INCLUDED
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "battle/entity.h"
+#include "battle/stats.h"
+#include "util/symbol.h"
+
+namespace battle {
+
+
+/// The contents of an entity file: everything needed to create the entity
+struct EntityTemplate {
+    Stats stats;                     ///< the base stats
+    std::vector<std::string> skills; ///< the names of the skills it knows
+    util::Symbol kind;               ///< interned, for entities made from it
+    util::Symbol type;               ///< likewise
+};
+
+/// Get the path of the entity file describing the given kind and type
+[[nodiscard]] std::string entityPath(const std::string& kind, const std::string& type);
+
+/// Look up one of the base stats by the name it goes by in entity files
+/// Returns nullptr if there isn't one by that name.
+[[nodiscard]] int* findBaseStat(Stats& stats, std::string_view name) noexcept;
+
+/// Read the entity file for the given kind and type
+/// Throws std::invalid_argument if the file is missing or malformed.
+[[nodiscard]] EntityTemplate loadEntityTemplate(const std::string& kind,
+                                                const std::string& type);
+
+/// Create a (level 1) entity from its entity file
+[[nodiscard]] std::shared_ptr<Entity> loadEntity(EntityID id);
+
+
+}
+
+#endif // BATTLE_ENTITYLOADER_H_INCLUDED
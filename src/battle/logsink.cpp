@@ -0,0 +1,77 @@
+#include "battle/logsink.h"
+
+#include <string_view>
+
+#include "battle/entity.h"
+#include "battle/skill.h"
+#include "battle/skilldetails.h"
+
+namespace battle {
+
+namespace {
+    // as `to_string', without making a string each time
+    std::string_view poolName(Pool pool) noexcept {
+        switch (pool) {
+        case Pool::Health: return "HP";
+        case Pool::Mana: return "MP";
+        case Pool::Tech: return "TP";
+        }
+        return "??";
+    }
+
+    const std::string& nameOf(const Entity& e) noexcept {
+        return e.getID().name;
+    }
+}
+
+
+void LogSink::operator()(const message::SkillUsed& su) noexcept {
+    out << nameOf(su.source) << " used " << su.skill->getDetails().getName()
+        << " on " << nameOf(su.target) << "!\n";
+}
+
+void LogSink::operator()(const message::Miss& m) noexcept {
+    out << nameOf(m.entity) << " avoided the attack!\n";
+}
+
+void LogSink::operator()(const message::Critical& c) noexcept {
+    out << nameOf(c.entity) << " took a critical hit!\n";
+}
+
+void LogSink::operator()(const message::PoolChanged& pc) noexcept {
+    const auto diff = pc.new_value - pc.old_value;
+    const auto pool = poolName(pc.pool);
+    if (diff < 0)
+        out << nameOf(pc.entity) << " lost " << -diff << ' ' << pool << "!\n";
+    else if (diff > 0)
+        out << nameOf(pc.entity) << " restored " << diff << ' ' << pool << "!\n";
+    else
+        out << nameOf(pc.entity) << "'s " << pool << " remained unchanged.\n";
+}
+
+void LogSink::operator()(const message::StatusEffect& e) noexcept {
+    if (e.applied)
+        out << nameOf(e.entity) << " is now affected by " << e.effect << "!\n";
+    else
+        out << nameOf(e.entity) << "'s " << e.effect << " wore off.\n";
+}
+
+void LogSink::operator()(const message::Defended& d) noexcept {
+    out << nameOf(d.entity) << " is defending!\n";
+}
+
+void LogSink::operator()(const message::Fled& f) noexcept {
+    out << nameOf(f.entity) << " attempted to flee"
+        << (f.succeeded ? ", and succeeded!\n" : "... but failed.\n");
+}
+
+void LogSink::operator()(const message::Died& d) noexcept {
+    out << nameOf(d.entity) << " died!\n";
+}
+
+void LogSink::operator()(const message::Notification& n) noexcept {
+    out << n.message << '\n';
+}
+
+
+}
@@ -0,0 +1,38 @@
+#ifndef BATTLE_LOGSINK_H_INCLUDED
+#define BATTLE_LOGSINK_H_INCLUDED
+
+#include "battle/messages.h"
+#include "util/logwriter.h"
+
+namespace battle {
+
+
+/// Writes each message out as a line of readable text, as the console shows it
+///
+/// This is a message sink (see battle/messagesink.h). Lines are formatted
+/// straight into `out', without any temporary strings; it's up to the owner
+/// of the buffer to `commit' at sensible points (e.g. after each turn).
+class LogSink {
+public:
+    explicit LogSink(util::LogBuffer& out) noexcept
+        : out{ out }
+    {}
+
+    void operator()(const message::SkillUsed& su) noexcept;
+    void operator()(const message::Miss& m) noexcept;
+    void operator()(const message::Critical& c) noexcept;
+    void operator()(const message::PoolChanged& pc) noexcept;
+    void operator()(const message::StatusEffect& e) noexcept;
+    void operator()(const message::Defended& d) noexcept;
+    void operator()(const message::Fled& f) noexcept;
+    void operator()(const message::Died& d) noexcept;
+    void operator()(const message::Notification& n) noexcept;
+
+private:
+    util::LogBuffer& out;
+};
+
+
+}
+
+#endif // BATTLE_LOGSINK_H_INCLUDED
@@ -0,0 +1,109 @@
+#include "battle/luaallocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace battle {
+
+
+LuaAllocator::~LuaAllocator() {
+    for (auto* page : pages)
+        std::free(page);
+}
+
+void* LuaAllocator::alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize) noexcept {
+    auto& self = *static_cast<LuaAllocator*>(ud);
+    const std::size_t old = ptr ? osize : 0;  // else osize is a type tag
+
+    if (nsize == 0) {
+        if (ptr) {
+            self.deallocate(ptr, old);
+            self.in_use -= old;
+        }
+        return nullptr;
+    }
+
+    // only growing can fail; lua assumes shrinking a block always works
+    if (nsize > old && self.in_use - old + nsize > self.limit)
+        return nullptr;
+
+    void* result = nullptr;
+    if (ptr && old > max_pooled && nsize > max_pooled) {
+        result = std::realloc(ptr, nsize);
+        if (!result)
+            return nullptr;
+        self.large = self.large - old + nsize;
+    } else if (ptr && old <= max_pooled && nsize <= max_pooled
+                   && classOf(old) == classOf(nsize)) {
+        result = ptr;
+    } else {
+        result = self.allocate(nsize);
+        if (!result)
+            return nullptr;
+        if (ptr) {
+            std::memcpy(result, ptr, std::min(old, nsize));
+            self.deallocate(ptr, old);
+        }
+    }
+
+    self.in_use = self.in_use - old + nsize;
+    self.peak_use = std::max(self.peak_use, self.in_use);
+    if (nsize > old)
+        self.total += nsize - old;
+    return result;
+}
+
+void* LuaAllocator::allocate(std::size_t size) noexcept {
+    if (size > max_pooled) {
+        auto* p = std::malloc(size);
+        if (p)
+            large += size;
+        return p;
+    }
+
+    const auto cls = classOf(size);
+    if (!free_lists[cls] && !refill(cls))
+        return nullptr;
+    auto* block = free_lists[cls];
+    free_lists[cls] = block->next;
+    return block;
+}
+
+void LuaAllocator::deallocate(void* ptr, std::size_t size) noexcept {
+    if (size > max_pooled) {
+        std::free(ptr);
+        large -= size;
+        return;
+    }
+
+    const auto cls = classOf(size);
+    auto* block = static_cast<FreeBlock*>(ptr);
+    block->next = free_lists[cls];
+    free_lists[cls] = block;
+}
+
+bool LuaAllocator::refill(std::size_t cls) noexcept {
+    auto* page = static_cast<unsigned char*>(std::malloc(page_size));
+    if (!page)
+        return false;
+    try {
+        pages.push_back(page);
+    } catch (...) {
+        std::free(page);
+        return false;
+    }
+
+    // thread the whole page onto the free list, lowest address first
+    const auto block_size = (cls + 1) * granule;
+    const auto count = page_size / block_size;
+    for (std::size_t i = count; i-- > 0; ) {
+        auto* block = reinterpret_cast<FreeBlock*>(page + i * block_size);
+        block->next = free_lists[cls];
+        free_lists[cls] = block;
+    }
+    return true;
+}
+
+
+}
@@ -0,0 +1,80 @@
+#ifndef BATTLE_LUAALLOCATOR_H_INCLUDED
+#define BATTLE_LUAALLOCATOR_H_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace battle {
+
+
+/// An allocator for a lua state (see `lua_Alloc'), with pools and a cap
+///
+/// Lua makes and drops lots of small objects. Rather than going to malloc
+/// for each of them, blocks of up to `max_pooled' bytes come from a free list
+/// per size class, refilled a page at a time; pages are kept until the
+/// allocator goes. Anything bigger goes straight to malloc.
+///
+/// It keeps count of the memory lua is using, and won't let that grow past
+/// the limit: lua then collects garbage and tries again, and raises a memory
+/// error if that doesn't free up enough.
+///
+/// One per lua state, which it must outlive; not thread safe.
+class LuaAllocator {
+public:
+    static constexpr std::size_t max_pooled = 512;       ///< bytes
+    static constexpr std::size_t page_size = 64 * 1024;  ///< bytes
+
+    LuaAllocator() = default;
+    ~LuaAllocator();
+
+    LuaAllocator(const LuaAllocator&) = delete;
+    LuaAllocator& operator=(const LuaAllocator&) = delete;
+
+    /// The `lua_Alloc' function; pass the allocator itself as `ud'
+    static void* alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize) noexcept;
+
+    /// Bytes lua is currently using
+    [[nodiscard]] std::size_t inUse() const noexcept { return in_use; }
+    /// The most bytes lua has used at once
+    [[nodiscard]] std::size_t peak() const noexcept { return peak_use; }
+    /// Bytes taken from the system, including pool pages not yet handed out
+    [[nodiscard]] std::size_t reserved() const noexcept {
+        return pages.size() * page_size + large;
+    }
+    /// Bytes ever handed to lua (growing a block counts the difference)
+    [[nodiscard]] std::uint64_t allocated() const noexcept { return total; }
+
+    [[nodiscard]] std::size_t getLimit() const noexcept { return limit; }
+    /// Set the most memory lua may use; doesn't free anything already in use
+    void setLimit(std::size_t bytes) noexcept { limit = bytes; }
+
+private:
+    static constexpr std::size_t granule = 16;
+    static constexpr std::size_t class_count = max_pooled / granule;
+
+    struct FreeBlock { FreeBlock* next; };
+
+    std::array<FreeBlock*, class_count> free_lists = {};
+    std::vector<void*> pages;
+
+    std::size_t in_use = 0;
+    std::size_t peak_use = 0;
+    std::size_t large = 0;  ///< bytes in blocks too big for the pools
+    std::uint64_t total = 0;
+    std::size_t limit = static_cast<std::size_t>(-1);
+
+    static std::size_t classOf(std::size_t size) noexcept {
+        return (size + granule - 1) / granule - 1;
+    }
+
+    void* allocate(std::size_t size) noexcept;
+    void deallocate(void* ptr, std::size_t size) noexcept;
+    bool refill(std::size_t cls) noexcept;
+};
+
+
+}
+
+#endif // BATTLE_LUAALLOCATOR_H_INCLUDED
@@ -0,0 +1,49 @@
+#ifndef BATTLE_LUAMEMORY_H_INCLUDED
+#define BATTLE_LUAMEMORY_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+namespace battle {
+
+
+// Memory and garbage collection for the calling thread's lua state.
+// Note: implementation in battle/config.cpp, alongside the state itself.
+//
+// The collector doesn't run by itself, so that it never lands in the middle
+// of a skill; instead `BattleSystem::doTurn' lets it catch up between turns,
+// and front ends can give it more time between battles. Should it fall too
+// far behind, lua still collects everything when it hits the memory limit.
+
+/// The most collection work done in one go between turns, in KiB allocated
+inline constexpr std::size_t turn_collect_kb = 64;
+
+/// How much memory each thread's lua state may use, unless changed
+inline constexpr std::size_t default_lua_memory_limit = std::size_t{ 256 } << 20;
+
+/// How much memory the lua state is using
+/// (only `in_use' is known under LuaJIT, which uses its own allocator)
+struct LuaMemory {
+    std::size_t in_use;     ///< bytes
+    std::size_t peak;       ///< bytes
+    std::size_t reserved;   ///< bytes taken from the system
+    std::size_t limit;      ///< bytes
+    std::uint64_t allocated;  ///< bytes, ever
+};
+
+[[nodiscard]] LuaMemory luaMemory();
+
+/// Cap the memory the lua state may use (no effect under LuaJIT)
+void setLuaMemoryLimit(std::size_t bytes);
+
+/// Do the collection work the collector would have done for everything
+/// allocated since last time, up to `max_kb' worth; the rest is carried over
+void stepLuaCollector(std::size_t max_kb = turn_collect_kb);
+
+/// Finish off a whole collection cycle
+void collectLuaGarbage();
+
+
+}
+
+#endif // BATTLE_LUAMEMORY_H_INCLUDED
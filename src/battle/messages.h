@@ -1,8 +1,12 @@
 #ifndef BATTLE_MESSAGES_H_INCLUDED
 #define BATTLE_MESSAGES_H_INCLUDED
 
+#include <array>
+#include <cstddef>
 #include <optional>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 #include "battle/skillref.h"
@@ -87,18 +91,90 @@ using Message = std::variant< message::SkillUsed
                             , message::Notification
                             >;
 
+/// Somewhere for messages to go as they happen, rather than being collected
 ///
+/// Refers to any object that can be called with each of the message types
+/// (see battle/messagesink.h for some). Which of its overloads handles a
+/// message is picked at compile time from the message's static type, so
+/// passing a message on costs one indirect call, and nothing is visited.
+/// The object must outlive the sink, and shouldn't throw.
+class MessageSink {
+public:
+    template <typename Impl, typename = std::enable_if_t<
+        !std::is_same_v<std::remove_cv_t<Impl>, MessageSink>>>
+    MessageSink(Impl& impl) noexcept
+        : object{ &impl }
+        , thunks{ &table<Impl> }
+    {}
+
+    /// Hand a message of a known type to the sink
+    template <typename M>
+    void operator()(const M& m) const noexcept {
+        (*thunks)[index<M>](object, &m);
+    }
+
+    /// Hand over a message whose type is only known at runtime
+    void operator()(const Message& m) const noexcept {
+        std::visit([this](const auto& alt) { (*this)(alt); }, m);
+    }
+
+private:
+    using Thunk = void (*)(void*, const void*);
+    static constexpr std::size_t count = std::variant_size_v<Message>;
+
+    template <typename M, std::size_t... I>
+    static constexpr std::size_t indexOf(std::index_sequence<I...>) noexcept {
+        static_assert((std::is_same_v<M, std::variant_alternative_t<I, Message>> || ...),
+                      "not a message type");
+        return ((std::is_same_v<M, std::variant_alternative_t<I, Message>> ? I : 0) + ...);
+    }
+    template <typename M>
+    static constexpr std::size_t index = indexOf<M>(std::make_index_sequence<count>{});
+
+    template <typename Impl, typename M>
+    static void thunk(void* object, const void* m) noexcept {
+        (*static_cast<Impl*>(object))(*static_cast<const M*>(m));
+    }
+
+    template <typename Impl, std::size_t... I>
+    static constexpr std::array<Thunk, count> makeTable(std::index_sequence<I...>) noexcept {
+        return { &thunk<Impl, std::variant_alternative_t<I, Message>>... };
+    }
+    template <typename Impl>
+    static constexpr std::array<Thunk, count> table =
+        makeTable<Impl>(std::make_index_sequence<count>{});
+
+    void* object;
+    const std::array<Thunk, count>* thunks;
+};
+
+/// Where the engine reports everything that happens
+///
+/// By default messages are collected, to be read back afterwards. Given a
+/// sink, they're passed straight to it instead and nothing is kept.
 class MessageLogger {
 public:
+    MessageLogger() = default;
+
+    /// Stream messages to `sink' rather than collecting them
+    explicit MessageLogger(MessageSink sink) noexcept
+        : sink{ sink }
+    {}
+
     /// Adds a new message to the log
     template <typename M>
     void appendMessage(M&& m) noexcept {
-        if constexpr (std::is_same_v<std::remove_cv_t<M>, message::SkillUsed>)
+        using T = std::remove_cv_t<std::remove_reference_t<M>>;
+        if constexpr (std::is_same_v<T, message::SkillUsed>)
             skill_used.emplace(m); // copy, not move
-        messages.emplace_back(std::forward<M>(m));
+        if (sink)
+            (*sink)(static_cast<const T&>(m));
+        else
+            messages.emplace_back(std::forward<M>(m));
     }
 
     /// Get a constant iterator to the start of the messages
+    /// (there aren't any when streaming to a sink)
     [[nodiscard]] decltype(auto) begin() const noexcept {
         return messages.cbegin();
     }
@@ -117,6 +193,7 @@ public:
     }
 
 private:
+    std::optional<MessageSink> sink;
     std::optional<message::SkillUsed> skill_used;
     std::vector<Message> messages;
 };
@@ -0,0 +1,75 @@
+#ifndef BATTLE_MESSAGESINK_H_INCLUDED
+#define BATTLE_MESSAGESINK_H_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <variant>
+#include "battle/messages.h"
+
+namespace battle {
+
+
+/// Throws every message away
+struct NullSink {
+    template <typename M>
+    void operator()(const M&) noexcept {}
+};
+
+/// Passes every message on to two other sinks, in order
+template <typename First, typename Second>
+struct TeeSink {
+    First& first;
+    Second& second;
+
+    template <typename M>
+    void operator()(const M& m) noexcept {
+        first(m);
+        second(m);
+    }
+};
+
+template <typename First, typename Second>
+TeeSink(First&, Second&) -> TeeSink<First, Second>;
+
+/// Keeps a running tally of what happened, without keeping the messages
+struct MessageCounter {
+    /// How many of each message type, indexed as in `Message'
+    std::array<std::size_t, std::variant_size_v<Message>> counts = {};
+
+    long damage_dealt = 0;    ///< total health lost, across everyone
+    long health_restored = 0; ///< total health regained, across everyone
+
+    template <typename M>
+    void operator()(const M&) noexcept {
+        counts[index<M>()]++;
+    }
+
+    void operator()(const message::PoolChanged& pc) noexcept {
+        counts[index<message::PoolChanged>()]++;
+        if (pc.pool != Pool::Health)
+            return;
+        if (pc.new_value < pc.old_value)
+            damage_dealt += pc.old_value - pc.new_value;
+        else
+            health_restored += pc.new_value - pc.old_value;
+    }
+
+    /// How many messages of type M were seen
+    template <typename M>
+    [[nodiscard]] std::size_t count() const noexcept { return counts[index<M>()]; }
+
+private:
+    template <typename M, std::size_t I = 0>
+    static constexpr std::size_t index() noexcept {
+        if constexpr (std::is_same_v<M, std::variant_alternative_t<I, Message>>)
+            return I;
+        else
+            return index<M, I + 1>();
+    }
+};
+
+
+}
+
+#endif // BATTLE_MESSAGESINK_H_INCLUDED
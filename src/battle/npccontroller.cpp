@@ -1,6 +1,7 @@
 #include "battle/npccontroller.h"
 
 #include "battle/battleview.h"
+#include "battle/blackboard.h"
 #include "battle/entity.h"
 #include "battle/skilldetails.h"
 #include "util/random.h"
@@ -14,7 +15,7 @@ NPCController::NPCController(Entity& entity)
 
 Action NPCController::go(const BattleView& view) {
     // TODO: improve the AI over just doing entirely random things
-    const auto skills = entity.getSkills();
+    const auto skills = entity.getUsableSkills();
     if (skills.empty() || util::random(1.0) < 0.2)
         return action::Defend{};
 
@@ -29,7 +30,12 @@ Action NPCController::go(const BattleView& view) {
     case SkillSpread::Single:
     case SkillSpread::SemiAoE:
     case SkillSpread::AoE:
-        return action::Skill{ choice, *util::random(view.enemies) };
+        // without a blackboard, anyone will do (even the dead)
+        if (!view.board || view.board->enemies.empty())
+            return action::Skill{ choice, *util::random(view.enemies) };
+        if (util::random(1.0) < focus_chance)
+            return action::Skill{ choice, *view.board->focus };
+        return action::Skill{ choice, *util::random(view.board->enemies) };
     }
 
     // shouldn't ever get here; just shut up GCC
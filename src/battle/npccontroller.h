@@ -13,6 +13,9 @@ class NPCController : public Controller {
 public:
     static constexpr bool nest_controller = false;
 
+    /// How often to go for the team's focus target, rather than anyone
+    static constexpr double focus_chance = 0.5;
+
     explicit NPCController(Entity& entity);
     [[nodiscard]] virtual Action go(const BattleView& view) override;
 
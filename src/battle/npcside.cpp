@@ -0,0 +1,45 @@
+#include "battle/npcside.h"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "battle/npccontroller.h"
+#include "battle/policycontroller.h"
+#include "battle/skill.h"
+#include "battle/utilitycontroller.h"
+
+namespace battle {
+
+
+void NPCSide::load() {
+    entity = loadEntityTemplate(kind, type);
+    if (ai == "policy")
+        policy = loadPolicy("default");
+}
+
+std::shared_ptr<Entity> NPCSide::makeEntity(long n) const {
+    std::vector<Skill> skills;
+    for (auto&& name : entity.skills)
+        skills.emplace_back(name, level);
+
+    auto e = std::make_shared<Entity>(
+        EntityID{ entity.kind, entity.type, type + " #" + std::to_string(n) },
+        1, entity.stats, std::move(skills));
+    if (ai == "utility")
+        e->assignController<UtilityController>();
+    else if (ai == "policy")
+        e->assignController<PolicyController>(policy);
+    else
+        e->assignController<NPCController>();
+    return e;
+}
+
+const std::string& checkAI(const std::string& name) {
+    if (name != "random" && name != "utility" && name != "policy")
+        throw std::invalid_argument("unknown AI '" + name + "'");
+    return name;
+}
+
+
+}
@@ -0,0 +1,40 @@
+#ifndef BATTLE_NPCSIDE_H_INCLUDED
+#define BATTLE_NPCSIDE_H_INCLUDED
+
+#include <memory>
+#include <string>
+#include "battle/entity.h"
+#include "battle/entityloader.h"
+
+namespace battle {
+
+
+class PolicyNetwork;
+
+/// One side of a battle between NPCs: who's on it, how strong they are, and
+/// which AI plays them. The simulator and the scenario benchmarks both
+/// make their teams from these.
+struct NPCSide {
+    std::string kind;
+    std::string type;
+    EntityTemplate entity = {};
+    int level = 1;              ///< of every skill they know
+    std::string ai = "random";  ///< which controller they get (see `checkAI')
+    std::shared_ptr<const PolicyNetwork> policy = nullptr;  ///< if a policy AI
+
+    /// Read the entity file, and the policy network if it's a policy AI.
+    /// Throws std::invalid_argument if either is missing or malformed.
+    void load();
+
+    /// Make the `n'th member of the side (from 1), with its controller
+    [[nodiscard]] std::shared_ptr<Entity> makeEntity(long n) const;
+};
+
+/// Check `name' is an AI that NPCSide knows about, and give it back
+/// Throws std::invalid_argument if it isn't.
+const std::string& checkAI(const std::string& name);
+
+
+}
+
+#endif // BATTLE_NPCSIDE_H_INCLUDED
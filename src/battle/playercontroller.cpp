@@ -13,9 +13,7 @@ PlayerController::PlayerController(Entity& entity)
 }
 
 Action PlayerController::go(const BattleView&) {
-    auto c = choice.value_or(action::UserChoice{ *this });
-    choice = std::nullopt;
-    return c;
+    return takeChoice().value_or(action::UserChoice{ *this });
 }
 
 UserOptions PlayerController::options() const {
@@ -30,5 +28,11 @@ void PlayerController::choose(const Action& act) {
     choice.emplace(act);
 }
 
+std::optional<Action> PlayerController::takeChoice() noexcept {
+    auto c = std::move(choice);
+    choice = std::nullopt;
+    return c;
+}
+
 
 }
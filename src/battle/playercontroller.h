@@ -32,6 +32,9 @@ public:
     [[nodiscard]] UserOptions options() const;
     void choose(const Action& act);
 
+    /// Take the action chosen by `choose', if there is one
+    [[nodiscard]] std::optional<Action> takeChoice() noexcept;
+
     [[nodiscard]] constexpr const Entity& getEntity() const noexcept {
         return entity;
     }
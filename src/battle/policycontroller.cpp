@@ -0,0 +1,261 @@
+#include "battle/policycontroller.h"
+
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "battle/battleview.h"
+#include "battle/blackboard.h"
+#include "battle/entity.h"
+#include "battle/skill.h"
+#include "battle/skilldetails.h"
+#include "util/trace.h"
+
+namespace battle {
+
+
+PolicyNetwork::PolicyNetwork(std::size_t targets, std::size_t skills,
+                             std::vector<util::DenseLayer> l)
+    : num_targets{ targets }
+    , num_skills{ skills }
+    , layers{ std::move(l) }
+{
+    if (layers.empty())
+        throw std::invalid_argument("PolicyNetwork: no layers");
+    std::size_t width = inputs();
+    for (const auto& layer : layers) {
+        if (layer.inputs() != width)
+            throw std::invalid_argument("PolicyNetwork: layer expects " +
+                std::to_string(layer.inputs()) + " inputs, but gets " + std::to_string(width));
+        width = layer.outputs();
+    }
+    if (width != outputs())
+        throw std::invalid_argument("PolicyNetwork: expected " + std::to_string(outputs()) +
+                                    " outputs, got " + std::to_string(width));
+}
+
+const float* PolicyNetwork::evaluate(const float* features, Workspace& ws) const {
+    TRACE_SCOPE("PolicyNetwork::evaluate");
+    const float* in = features;
+    for (const auto& layer : layers) {
+        ws.back.resize(layer.outputs());
+        layer.apply(in, ws.back.data(), ws.layer);
+        std::swap(ws.front, ws.back);
+        in = ws.front.data();
+    }
+    return in;
+}
+
+std::string policyPath(const std::string& name) {
+    return "./data/ai/" + name + ".policy";
+}
+
+std::shared_ptr<const PolicyNetwork> loadPolicy(const std::string& name) {
+    const std::string path = policyPath(name);
+    std::ifstream in{ path };
+    if (!in) throw std::invalid_argument("couldn't open '" + path + "'.");
+
+    struct Layer {
+        std::size_t outputs;
+        util::DenseLayer::Activation activation;
+        util::DenseLayer::Precision precision;
+        std::vector<float> weights;
+        std::vector<float> bias;
+    };
+    std::size_t targets = 0, skills = 0;
+    std::vector<Layer> pending;
+
+    std::string line;
+    for (int num = 1; std::getline(in, line); num++) {
+        const auto fail = [&](const std::string& what) {
+            return std::invalid_argument(path + ":" + std::to_string(num) + ": " + what);
+        };
+
+        std::istringstream iss{ line.substr(0, line.find('#')) };
+        std::string key;
+        if (!(iss >> key))
+            continue;
+
+        const auto numbers = [&](std::vector<float>& out) {
+            for (float x; iss >> x; )
+                out.push_back(x);
+            if (!iss.eof())
+                throw fail("expected numbers");
+        };
+
+        if (key == "targets") iss >> targets;
+        else if (key == "skills") iss >> skills;
+        else if (key == "layer") {
+            std::string activation, precision;
+            Layer layer{};
+            iss >> layer.outputs >> activation >> precision;
+            if (activation == "relu") layer.activation = util::DenseLayer::Activation::Relu;
+            else if (activation == "linear") layer.activation = util::DenseLayer::Activation::Linear;
+            else throw fail("activation must be 'relu' or 'linear'");
+            if (precision == "float") layer.precision = util::DenseLayer::Precision::Float;
+            else if (precision == "int8") layer.precision = util::DenseLayer::Precision::Int8;
+            else throw fail("precision must be 'float' or 'int8'");
+            pending.push_back(std::move(layer));
+        } else if (key == "w" || key == "b") {
+            if (pending.empty())
+                throw fail("'" + key + "' before any 'layer'");
+            numbers(key == "w" ? pending.back().weights : pending.back().bias);
+            continue;
+        } else
+            throw fail("unknown key '" + key + "'");
+
+        if (iss.fail())
+            throw fail("bad value for '" + key + "'");
+    }
+
+    // now the sizes are known, each layer's inputs follow from the last's
+    std::vector<util::DenseLayer> layers;
+    std::size_t width = PolicyNetwork::entity_features * (1 + targets)
+                      + PolicyNetwork::skill_features * skills;
+    try {
+        for (auto& l : pending) {
+            layers.emplace_back(width, l.outputs, l.weights, std::move(l.bias),
+                                l.activation, l.precision);
+            width = l.outputs;
+        }
+        return std::make_shared<const PolicyNetwork>(targets, skills, std::move(layers));
+    } catch (const std::invalid_argument& e) {
+        throw std::invalid_argument(path + ": " + e.what());
+    }
+}
+
+
+namespace {
+
+    // fill in one entity's worth of features
+    void describe(const Entity& e, double threat, float* out) noexcept {
+        Stats scratch;
+        const auto& stats = e.getStats(scratch);
+        const auto& pools = e.getPools();
+        const auto fraction = [](int value, int max) {
+            return max > 0 ? static_cast<float>(value) / static_cast<float>(max) : 0.0f;
+        };
+        const auto tenth = [](int value) { return static_cast<float>(value) / 10.0f; };
+
+        out[0] = 1.0f;
+        out[1] = fraction(pools.health, stats.max_health);
+        out[2] = fraction(pools.mana, stats.max_mana);
+        out[3] = fraction(pools.tech, stats.max_tech);
+        out[4] = static_cast<float>(stats.max_health) / 100.0f;
+        out[5] = tenth(stats.p_atk);
+        out[6] = tenth(stats.p_def);
+        out[7] = tenth(stats.m_atk);
+        out[8] = tenth(stats.m_def);
+        out[9] = tenth(stats.skill);
+        out[10] = tenth(stats.evade);
+        out[11] = static_cast<float>(e.getAppliedStatusEffects().size()) / 4.0f;
+        out[12] = stats.react > 0 ? 10.0f / static_cast<float>(stats.react) : 0.0f;
+        out[13] = static_cast<float>(threat / 10.0);
+    }
+
+    void describe(const SkillDetails& details, bool usable, float* out) noexcept {
+        const auto cost = details.getHealthCost().value_or(0)
+                        + details.getManaCost().value_or(0)
+                        + details.getTechCost().value_or(0);
+        const auto spread = details.getSpread();
+
+        out[0] = usable ? 1.0f : 0.0f;
+        out[1] = static_cast<float>(details.getPower().value_or(0)) / 100.0f;
+        out[2] = static_cast<float>(details.getAccuracy().value_or(0)) / 100.0f;
+        out[3] = static_cast<float>(cost) / 10.0f;
+        out[4] = spread == SkillSpread::SemiAoE || spread == SkillSpread::AoE
+              || spread == SkillSpread::Field ? 1.0f : 0.0f;
+        out[5] = spread == SkillSpread::Self ? 1.0f : 0.0f;
+    }
+
+}
+
+PolicyFeatures::PolicyFeatures(std::size_t targets, std::size_t skills)
+    : num_targets{ targets }
+    , num_skills{ skills }
+    , features(PolicyNetwork::entity_features * (1 + targets)
+               + PolicyNetwork::skill_features * skills)
+{
+}
+
+void PolicyFeatures::encode(const Entity& entity, const BattleView& view) {
+    slots.clear();
+    const auto& enemies = view.board ? view.board->enemies : view.enemies;
+    for (Entity* e : enemies) {
+        if (slots.size() == num_targets)
+            break;
+        if (!e->isDead())
+            slots.push_back(e);
+    }
+
+    std::fill(std::begin(features), std::end(features), 0.0f);
+    float* out = features.data();
+    describe(entity, 0.0, out);
+    out += PolicyNetwork::entity_features;
+    for (std::size_t i = 0; i < num_targets; i++, out += PolicyNetwork::entity_features)
+        if (i < slots.size())
+            describe(*slots[i], view.board ? view.board->threatOf(*slots[i]) : 0.0, out);
+
+    const auto skills = entity.getUsableSkills();
+    usable_skills.assign(std::min(num_skills, skills.total()), false);
+    for (auto it = skills.begin(); it != skills.end(); ++it)
+        if (it.position() < usable_skills.size())
+            usable_skills[it.position()] = true;
+    for (std::size_t i = 0; i < usable_skills.size(); i++, out += PolicyNetwork::skill_features)
+        describe(skills[i]->getDetails(), usable_skills[i], out);
+}
+
+
+PolicyController::PolicyController(Entity& entity, std::shared_ptr<const PolicyNetwork> net)
+    : entity{ entity }
+    , network{ std::move(net) }
+    , features{ network ? network->targets() : 0, network ? network->skills() : 0 }
+{
+    if (!network)
+        throw std::invalid_argument("PolicyController: no network");
+}
+
+Action PolicyController::go(const BattleView& view) {
+    TRACE_SCOPE("PolicyController::go");
+    const auto num_skills = network->skills();
+
+    features.encode(entity, view);
+    const auto& usable = features.usable();
+    const auto& slots = features.targets();
+    const float* logits = network->evaluate(features.values().data(), workspace);
+
+    // the best usable skill, if it beats defending
+    std::optional<std::size_t> skill;
+    float best = logits[num_skills];
+    for (std::size_t i = 0; i < usable.size(); i++) {
+        if (usable[i] && logits[i] > best) {
+            best = logits[i];
+            skill = i;
+        }
+    }
+    if (!skill)
+        return action::Defend{};
+
+    const SkillRef choice = entity.getUsableSkills()[*skill];
+    switch (choice->getDetails().getSpread()) {
+    case SkillSpread::Self:
+    case SkillSpread::Field:
+        return action::Skill{ choice, entity };
+
+    case SkillSpread::Single:
+    case SkillSpread::SemiAoE:
+    case SkillSpread::AoE:
+        break;
+    }
+
+    if (slots.empty())
+        return action::Defend{};
+    const float* target_logits = logits + num_skills + 1;
+    const auto target = std::max_element(target_logits, target_logits + slots.size());
+    return action::Skill{ choice, *slots[static_cast<std::size_t>(target - target_logits)] };
+}
+
+}
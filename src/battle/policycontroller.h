@@ -0,0 +1,146 @@
+#ifndef BATTLE_POLICYCONTROLLER_H_INCLUDED
+#define BATTLE_POLICYCONTROLLER_H_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "battle/controller.h"
+#include "util/dense.h"
+
+namespace battle {
+
+class Entity;
+struct BattleView;
+
+/// A small neural network that decides what an NPC does
+///
+/// It looks at a fixed-size feature vector describing the entity, its first
+/// `targets' living enemies, and its first `skills' skills, and gives a
+/// score (logit) for each skill, for defending, and for each target. See
+/// PolicyController for exactly what goes in and how the scores are used.
+///
+/// Networks are read only once loaded, so one can be shared by any number of
+/// controllers, on any number of threads.
+class PolicyNetwork {
+public:
+    /// Features describing each entity (the controlled one, then each target)
+    static constexpr std::size_t entity_features = 14;
+    /// Features describing each of the controlled entity's skills
+    static constexpr std::size_t skill_features = 6;
+
+    /// Throws std::invalid_argument if the layers don't fit together, or
+    /// don't fit the number of targets and skills
+    PolicyNetwork(std::size_t targets, std::size_t skills,
+                  std::vector<util::DenseLayer> layers);
+
+    [[nodiscard]] std::size_t targets() const noexcept { return num_targets; }
+    [[nodiscard]] std::size_t skills() const noexcept { return num_skills; }
+
+    [[nodiscard]] std::size_t inputs() const noexcept {
+        return entity_features * (1 + num_targets) + skill_features * num_skills;
+    }
+    /// A logit per skill, then one for defending, then one per target
+    [[nodiscard]] std::size_t outputs() const noexcept {
+        return num_skills + 1 + num_targets;
+    }
+
+    /// Somewhere to evaluate the network; one per thread (or controller)
+    struct Workspace {
+        std::vector<float> front;
+        std::vector<float> back;
+        util::DenseLayer::Workspace layer;
+    };
+
+    /// Run the network on `inputs' features, returning its `outputs' logits
+    /// (which live in `ws' until it's next used)
+    const float* evaluate(const float* features, Workspace& ws) const;
+
+private:
+    std::size_t num_targets;
+    std::size_t num_skills;
+    std::vector<util::DenseLayer> layers;
+};
+
+/// Get the path of the policy file with the given name
+[[nodiscard]] std::string policyPath(const std::string& name);
+
+/// Read a policy file; lines are of the form
+///     targets 4                  # how many enemies the network looks at
+///     skills 4                   # how many skills it looks at
+///     layer 16 relu float        # outputs, relu/linear, float/int8
+///     w 0.5 -1 ...               # one line of weights per output
+///     b 0 0.1 ...                # the biases, one per output
+/// Each layer takes the outputs of the one before it (or the features).
+/// Throws std::invalid_argument if the file is missing or malformed.
+[[nodiscard]] std::shared_ptr<const PolicyNetwork> loadPolicy(const std::string& name);
+
+
+/// The features a PolicyNetwork is given, worked out from what an entity sees
+///
+/// For the entity itself and then for each target slot: whether the slot is
+/// filled, the fraction of each pool left, maximum health / 100, the other
+/// base stats / 10, the number of status effects / 4, how long between their
+/// turns (10 / react) and, for targets, their threat to the team from the
+/// blackboard / 10. Then, for each skill slot: whether it's usable,
+/// power / 100, accuracy / 100, total cost / 10, whether it hits more than
+/// one target, and whether it targets the user.
+///
+/// Targets are the first living enemies, in the blackboard's order; empty
+/// slots (and skill slots past the entity's last skill) are all zeroes.
+class PolicyFeatures {
+public:
+    PolicyFeatures(std::size_t targets, std::size_t skills);
+
+    /// Work out the features for `entity' from `view'
+    void encode(const Entity& entity, const BattleView& view);
+
+    /// The features, as worked out by the last `encode'
+    [[nodiscard]] const std::vector<float>& values() const noexcept { return features; }
+
+    /// Who's in each filled target slot
+    [[nodiscard]] const std::vector<Entity*>& targets() const noexcept { return slots; }
+
+    /// Whether the skill in each slot is usable, for as many skill slots as
+    /// the entity has skills
+    [[nodiscard]] const std::vector<bool>& usable() const noexcept { return usable_skills; }
+
+    [[nodiscard]] std::size_t targetSlots() const noexcept { return num_targets; }
+    [[nodiscard]] std::size_t skillSlots() const noexcept { return num_skills; }
+
+private:
+    std::size_t num_targets;
+    std::size_t num_skills;
+    std::vector<float> features;
+    std::vector<Entity*> slots;
+    std::vector<bool> usable_skills;
+};
+
+
+/// AI controller that does whatever a PolicyNetwork says to
+///
+/// The highest scoring usable skill is used (unless defending scores higher)
+/// on the highest scoring filled target slot; see PolicyFeatures for what the
+/// network is given. There's no dice involved: the same battle gets the same
+/// decision.
+class PolicyController : public Controller {
+public:
+    static constexpr bool nest_controller = false;
+
+    PolicyController(Entity& entity, std::shared_ptr<const PolicyNetwork> network);
+    [[nodiscard]] virtual Action go(const BattleView& view) override;
+
+    /// What the network was given by the last `go'
+    [[nodiscard]] const PolicyFeatures& lastFeatures() const noexcept { return features; }
+
+private:
+    Entity& entity; ///< the owning entity
+    std::shared_ptr<const PolicyNetwork> network;
+
+    PolicyFeatures features;
+    PolicyNetwork::Workspace workspace;
+};
+
+}
+
+#endif // BATTLE_POLICYCONTROLLER_H_INCLUDED
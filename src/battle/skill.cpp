@@ -7,17 +7,17 @@
 namespace battle {
 
 Skill::Skill(const std::string& name, int level)
-    : details{ name, level }
+    : details{ SkillDetails::shared(name, level) }
 {
 }
 
 bool Skill::isUsableBy(const Entity& source) const noexcept {
     // note: std::nullopt < x for all x
-    if (details.getHealthCost() > source.get<Pool::Health>())
+    if (details->getHealthCost() > source.get<Pool::Health>())
         return false;
-    if (details.getManaCost() > source.get<Pool::Mana>())
+    if (details->getManaCost() > source.get<Pool::Mana>())
         return false;
-    if (details.getTechCost() > source.get<Pool::Tech>())
+    if (details->getTechCost() > source.get<Pool::Tech>())
         return false;
     // TODO items
     return true;
@@ -30,16 +30,16 @@ void Skill::use(MessageLogger& logger,
 {
     logger.appendMessage(message::SkillUsed{ *this, source, target });
     processCost(logger, source);
-    details.perform(logger, source, target, system);
+    details->perform(logger, source, target, system);
 }
 
 void Skill::processCost(MessageLogger& logger, Entity& source) const noexcept {
     // rewrite with expansion statements when C++20 becomes a thing
-    if (auto cost = details.getHealthCost(); cost)
+    if (auto cost = details->getHealthCost(); cost)
         source.drain<Pool::Health>(logger, *cost);
-    if (auto cost = details.getManaCost(); cost)
+    if (auto cost = details->getManaCost(); cost)
         source.drain<Pool::Mana>(logger, *cost);
-    if (auto cost = details.getTechCost(); cost)
+    if (auto cost = details->getTechCost(); cost)
         source.drain<Pool::Tech>(logger, *cost);
     // TODO items
 }
@@ -30,13 +30,13 @@ public:
              BattleSystem& system) const;
 
     const SkillDetails& getDetails() const noexcept {
-        return details;
+        return *details;
     }
 
 private:
     void processCost(MessageLogger& logger, Entity& source) const noexcept;
 
-    SkillDetails details;
+    std::shared_ptr<const SkillDetails> details;
     std::vector<std::string> perks_applied;
 };
 
@@ -37,10 +37,17 @@ enum class SkillMethod {
 /// Immutable structure encapsulating the unchanging parts of a skill
 /// This includes: attributes, costs, and the `perform' function.
 /// Note: implementation currently in battle/config.cpp
+/// Note: tied to the calling thread's lua state; don't share across threads.
 class SkillDetails {
 public:
     SkillDetails(const std::string& name, int level);
 
+    /// Get the details of a skill at a given level, shared with everyone else
+    /// on this thread who asked for the same one. Skill tables are read only,
+    /// so there's no need to build a fresh one for every entity (or battle).
+    [[nodiscard]] static std::shared_ptr<const SkillDetails>
+    shared(const std::string& name, int level);
+
     // TODO: make copyable? (possible, but do we want to is the question)
 
     [[nodiscard]] const std::string& getName() const noexcept { return name; }
@@ -0,0 +1,72 @@
+#include "battle/skillprofile.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace battle {
+
+
+void SkillProfile::merge(const SkillProfile& other) {
+    calls += other.calls;
+    instructions += other.instructions;
+    bytes_allocated += other.bytes_allocated;
+    nanoseconds.merge(other.nanoseconds);
+}
+
+void mergeSkillProfiles(std::vector<SkillProfile>& into,
+                        const std::vector<SkillProfile>& from)
+{
+    for (auto&& p : from) {
+        auto it = std::find_if(into.begin(), into.end(), [&p](auto&& q) {
+            return q.name == p.name && q.level == p.level;
+        });
+        if (it == into.end())
+            into.push_back(p);
+        else
+            it->merge(p);
+    }
+}
+
+void writeSkillProfiles(std::ostream& os, std::vector<SkillProfile> profiles,
+                        std::size_t top)
+{
+    std::sort(profiles.begin(), profiles.end(), [](auto&& a, auto&& b) {
+        return a.nanoseconds.sum() > b.nanoseconds.sum();
+    });
+    if (profiles.size() > top)
+        profiles.resize(top);
+
+    const auto per_call = [](std::uint64_t total, std::uint64_t calls) {
+        return calls == 0 ? 0.0 : static_cast<double>(total) / static_cast<double>(calls);
+    };
+
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+    os << std::left << std::setw(24) << "skill" << std::right
+       << std::setw(6) << "level"
+       << std::setw(12) << "calls"
+       << std::setw(12) << "total ms"
+       << std::setw(10) << "mean us"
+       << std::setw(10) << "p99 us"
+       << std::setw(12) << "instr/call"
+       << std::setw(12) << "bytes/call" << "\n";
+    for (auto&& p : profiles) {
+        const auto& t = p.nanoseconds;
+        os << std::left << std::setw(24) << p.name << std::right
+           << std::setw(6) << p.level
+           << std::setw(12) << p.calls
+           << std::setw(12) << static_cast<double>(t.sum()) / 1e6
+           << std::setw(10) << t.mean() / 1e3
+           << std::setw(10) << static_cast<double>(t.percentile(99)) / 1e3
+           << std::setw(12) << per_call(p.instructions, p.calls)
+           << std::setw(12) << per_call(p.bytes_allocated, p.calls) << "\n";
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+
+}
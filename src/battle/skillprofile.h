@@ -0,0 +1,50 @@
+#ifndef BATTLE_SKILLPROFILE_H_INCLUDED
+#define BATTLE_SKILLPROFILE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "util/histogram.h"
+
+namespace battle {
+
+
+/// What running one skill's `perform' has cost, over every call to it
+struct SkillProfile {
+    std::string name;
+    int level = 1;
+
+    std::uint64_t calls = 0;
+    std::uint64_t instructions = 0;     ///< lua instructions (sampled; see below)
+    std::uint64_t bytes_allocated = 0;  ///< by lua, while performing
+    util::Histogram nanoseconds;        ///< wall time, per call
+
+    void merge(const SkillProfile& other);
+};
+
+/// Instructions are counted by a lua hook every this many instructions, and
+/// put down to whichever skill is running at the time; so the totals are only
+/// accurate over lots of calls. (Under LuaJIT, compiled code isn't counted.)
+inline constexpr int profile_hook_interval = 128;
+
+/// Start (or stop) profiling skills performed on the calling thread.
+/// Note: implementation in battle/config.cpp, as it's tied to the lua state.
+void setSkillProfiling(bool on);
+
+/// Hand over the calling thread's profiles, starting afresh
+[[nodiscard]] std::vector<SkillProfile> takeSkillProfiles();
+
+/// Fold profiles (e.g. from other threads) into `into', by name and level
+void mergeSkillProfiles(std::vector<SkillProfile>& into,
+                        const std::vector<SkillProfile>& from);
+
+/// Write a table of the `top' most expensive skills, by total time taken
+void writeSkillProfiles(std::ostream& os, std::vector<SkillProfile> profiles,
+                        std::size_t top);
+
+
+}
+
+#endif // BATTLE_SKILLPROFILE_H_INCLUDED
@@ -0,0 +1,291 @@
+#include "battle/statistics.h"
+
+#include <algorithm>
+#include <string_view>
+
+#include "battle/battlesystem.h"
+#include "battle/entity.h"
+#include "battle/skill.h"
+#include "battle/skilldetails.h"
+
+namespace battle {
+
+void writeJSONString(std::ostream& os, std::string_view s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            os << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            os << ' ';
+        else
+            os << c;
+    }
+    os << '"';
+}
+
+namespace {
+
+    void writeHistogram(std::ostream& os, const util::Histogram& h) {
+        os << "{\"count\":" << h.count()
+           << ",\"sum\":" << h.sum()
+           << ",\"mean\":" << h.mean()
+           << ",\"min\":" << h.min()
+           << ",\"p50\":" << h.percentile(50)
+           << ",\"p90\":" << h.percentile(90)
+           << ",\"p99\":" << h.percentile(99)
+           << ",\"max\":" << h.max() << '}';
+    }
+
+    double ratio(std::uint64_t num, std::uint64_t den) {
+        return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den);
+    }
+
+    void writeSkill(std::ostream& os, const Statistics::SkillTally& t) {
+        const auto hits = t.damage.count() + t.healing.count();
+        os << "{\"uses\":" << t.uses
+           << ",\"misses\":" << t.misses
+           << ",\"criticals\":" << t.criticals
+           << ",\"hit_rate\":" << ratio(hits, hits + t.misses)
+           << ",\"damage\":";
+        writeHistogram(os, t.damage);
+        os << ",\"healing\":";
+        writeHistogram(os, t.healing);
+        os << '}';
+    }
+
+    void writeEntity(std::ostream& os, const Statistics::EntityTally& t) {
+        os << "{\"battles\":" << t.battles
+           << ",\"wins\":" << t.wins
+           << ",\"attacks\":" << t.attacks
+           << ",\"targeted\":" << t.targeted
+           << ",\"evaded\":" << t.evaded
+           << ",\"evade_rate\":" << ratio(t.evaded, t.targeted)
+           << ",\"criticals_taken\":" << t.criticals_taken
+           << ",\"deaths\":" << t.deaths
+           << ",\"damage_dealt\":";
+        writeHistogram(os, t.damage_dealt);
+        os << ",\"damage_taken\":";
+        writeHistogram(os, t.damage_taken);
+        os << ",\"turns_to_die\":";
+        writeHistogram(os, t.turns_to_die);
+        os << '}';
+    }
+
+}
+
+
+void Statistics::SkillTally::merge(const SkillTally& other) {
+    uses += other.uses;
+    misses += other.misses;
+    criticals += other.criticals;
+    damage.merge(other.damage);
+    healing.merge(other.healing);
+}
+
+void Statistics::EntityTally::merge(const EntityTally& other) {
+    battles += other.battles;
+    wins += other.wins;
+    attacks += other.attacks;
+    targeted += other.targeted;
+    evaded += other.evaded;
+    criticals_taken += other.criticals_taken;
+    deaths += other.deaths;
+    damage_dealt.merge(other.damage_dealt);
+    damage_taken.merge(other.damage_taken);
+    turns_to_die.merge(other.turns_to_die);
+}
+
+
+void Statistics::beginBattle(const BattleSystem& system) {
+    current = &system;
+    participants.clear();
+    known_skills.clear();
+    turns = 0;
+    source = nullptr;
+    source_tally = nullptr;
+    skill_tally = nullptr;
+    element_tally = nullptr;
+
+    for (auto team : { Team::Blue, Team::Red })
+        for (auto* e : system.teamMembersOf(team))
+            tallyFor(*e).battles++;
+}
+
+void Statistics::endBattle(const BattleSystem& system) {
+    const auto alive = [&system](Team team) {
+        auto members = system.teamMembersOf(team);
+        return std::any_of(members.begin(), members.end(),
+                           [](const Entity* e) { return !e->isDead(); });
+    };
+    const bool blue = alive(Team::Blue);
+    const bool red = alive(Team::Red);
+
+    // nobody wins if the battle was cut short, or everyone fled
+    if (blue != red) {
+        const auto winner = blue ? Team::Blue : Team::Red;
+        (winner == Team::Blue ? blue_wins : red_wins)++;
+        for (auto&& p : participants)
+            if (p.team == winner)
+                p.tally->wins++;
+    }
+
+    battles++;
+    battle_turns.add(turns);
+    current = nullptr;
+}
+
+void Statistics::merge(const Statistics& other) {
+    battles += other.battles;
+    blue_wins += other.blue_wins;
+    red_wins += other.red_wins;
+    battle_turns.merge(other.battle_turns);
+
+    for (auto&& [name, tally] : other.by_skill)
+        by_skill[name].merge(tally);
+    for (auto&& [key, tally] : other.by_entity)
+        by_entity[key].merge(tally);
+    for (std::size_t i = 0; i < by_element.size(); i++)
+        by_element[i].merge(other.by_element[i]);
+}
+
+
+void Statistics::operator()(const message::SkillUsed& m) {
+    const auto& details = m.skill->getDetails();
+    turns++;
+
+    source = &m.source;
+    source_tally = &tallyFor(m.source);
+    skill_tally = &tallyFor(details);
+    element_tally = &by_element[static_cast<std::size_t>(details.getElement())];
+
+    source_tally->attacks++;
+    skill_tally->uses++;
+    element_tally->uses++;
+}
+
+void Statistics::operator()(const message::Miss& m) {
+    if (!skill_tally)
+        return;
+    skill_tally->misses++;
+    element_tally->misses++;
+
+    auto& target = tallyFor(m.entity);
+    target.targeted++;
+    target.evaded++;
+}
+
+void Statistics::operator()(const message::Critical& m) {
+    if (!skill_tally)
+        return;
+    skill_tally->criticals++;
+    element_tally->criticals++;
+    tallyFor(m.entity).criticals_taken++;
+}
+
+void Statistics::operator()(const message::PoolChanged& m) {
+    if (!skill_tally || m.pool != Pool::Health)
+        return;
+
+    if (m.new_value > m.old_value) {
+        const auto amount = static_cast<std::uint64_t>(m.new_value - m.old_value);
+        skill_tally->healing.add(amount);
+        element_tally->healing.add(amount);
+        return;
+    }
+
+    // the user paying for the skill isn't damage
+    if (&m.entity == source)
+        return;
+
+    const auto amount = static_cast<std::uint64_t>(m.old_value - m.new_value);
+    skill_tally->damage.add(amount);
+    element_tally->damage.add(amount);
+    source_tally->damage_dealt.add(amount);
+
+    auto& target = tallyFor(m.entity);
+    target.targeted++;
+    target.damage_taken.add(amount);
+}
+
+void Statistics::operator()(const message::Died& m) {
+    auto& tally = tallyFor(m.entity);
+    tally.deaths++;
+    tally.turns_to_die.add(turns);
+}
+
+
+void Statistics::write(std::ostream& os) const {
+    os << "{\"battles\":" << battles
+       << ",\"blue_wins\":" << blue_wins
+       << ",\"red_wins\":" << red_wins
+       << ",\"turns\":";
+    writeHistogram(os, battle_turns);
+
+    os << ",\"skills\":{";
+    const char* sep = "";
+    for (auto&& [name, tally] : by_skill) {
+        os << sep;
+        writeJSONString(os, name);
+        os << ':';
+        writeSkill(os, tally);
+        sep = ",";
+    }
+
+    os << "},\"elements\":{";
+    sep = "";
+    for (std::size_t i = 0; i < by_element.size(); i++) {
+        if (by_element[i].uses == 0)
+            continue;
+        os << sep;
+        writeJSONString(os, elementName(static_cast<Element>(i)));
+        os << ':';
+        writeSkill(os, by_element[i]);
+        sep = ",";
+    }
+
+    // symbols are in the order they were first seen, which can change from
+    // run to run, so sort by name to keep the output the same
+    std::vector<std::pair<std::string, const EntityTally*>> entities;
+    for (auto&& [key, tally] : by_entity)
+        entities.emplace_back(key.first.str() + "/" + key.second.str(), &tally);
+    std::sort(entities.begin(), entities.end());
+
+    os << "},\"entities\":{";
+    sep = "";
+    for (auto&& [name, tally] : entities) {
+        os << sep;
+        writeJSONString(os, name);
+        os << ':';
+        writeEntity(os, *tally);
+        sep = ",";
+    }
+    os << "}}";
+}
+
+
+Statistics::EntityTally& Statistics::tallyFor(const Entity& e) {
+    for (auto&& p : participants)
+        if (p.entity == &e)
+            return *p.tally;
+
+    const auto& id = e.getID();
+    auto& tally = by_entity[EntityKey{ id.kind, id.type }];
+    const auto team = current ? current->teamOf(e) : Team::Blue;
+    participants.push_back({ &e, &tally, team });
+    return tally;
+}
+
+Statistics::SkillTally& Statistics::tallyFor(const SkillDetails& details) {
+    for (auto&& k : known_skills)
+        if (k.details == &details)
+            return *k.tally;
+
+    auto it = by_skill.find(details.getName());
+    if (it == by_skill.end())
+        it = by_skill.emplace(details.getName(), SkillTally{}).first;
+    known_skills.push_back({ &details, &it->second });
+    return it->second;
+}
+
+
+}
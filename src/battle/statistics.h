@@ -0,0 +1,138 @@
+#ifndef BATTLE_STATISTICS_H_INCLUDED
+#define BATTLE_STATISTICS_H_INCLUDED
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "battle/element.h"
+#include "battle/messages.h"
+#include "util/histogram.h"
+#include "util/symbol.h"
+
+namespace battle {
+
+class BattleSystem;
+class Entity;
+class SkillDetails;
+enum class Team;
+
+/// Running totals for lots of battles, gathered as their messages happen
+///
+/// This is a message sink (see battle/messagesink.h): point a battle at it
+/// with `BattleSystem::setMessageSink', and bracket the battle with
+/// `beginBattle' and `endBattle'. Damage, misses and crits are put down to
+/// whichever skill was used last. Nothing is locked, so give each thread
+/// its own, and `merge' them together once the threads have finished.
+class Statistics {
+public:
+    /// Numbers kept per skill name, and per element
+    struct SkillTally {
+        std::uint64_t uses = 0;      ///< how many times it was used
+        std::uint64_t misses = 0;    ///< targets who avoided it
+        std::uint64_t criticals = 0; ///< targets it crit
+        util::Histogram damage;      ///< health lost by each target hit
+        util::Histogram healing;     ///< health regained by each target
+
+        void merge(const SkillTally& other);
+    };
+
+    /// Numbers kept per entity kind/type
+    struct EntityTally {
+        std::uint64_t battles = 0;          ///< battles fought
+        std::uint64_t wins = 0;             ///< battles its team won
+        std::uint64_t attacks = 0;          ///< skills used
+        std::uint64_t targeted = 0;         ///< skills that hit or missed it
+        std::uint64_t evaded = 0;           ///< skills that missed it
+        std::uint64_t criticals_taken = 0;  ///< crits it received
+        std::uint64_t deaths = 0;
+        util::Histogram damage_dealt;       ///< per target hit
+        util::Histogram damage_taken;       ///< per hit received
+        util::Histogram turns_to_die;       ///< battle turns until it fell
+
+        void merge(const EntityTally& other);
+    };
+
+    /// Start recording a new battle between `system''s current combatants
+    void beginBattle(const BattleSystem& system);
+
+    /// Finish recording the current battle, noting who (if anyone) won
+    void endBattle(const BattleSystem& system);
+
+    /// Fold another thread's numbers into this one.
+    /// Neither should be partway through a battle.
+    void merge(const Statistics& other);
+
+    /// Write everything out as a JSON object
+    void write(std::ostream& os) const;
+
+    void operator()(const message::SkillUsed& m);
+    void operator()(const message::Miss& m);
+    void operator()(const message::Critical& m);
+    void operator()(const message::PoolChanged& m);
+    void operator()(const message::Died& m);
+    void operator()(const message::Defended&) noexcept { turns++; }
+    void operator()(const message::Fled&) noexcept { turns++; }
+    void operator()(const message::StatusEffect&) noexcept {}
+    void operator()(const message::Notification&) noexcept {}
+
+    [[nodiscard]] std::uint64_t battleCount() const noexcept { return battles; }
+    [[nodiscard]] std::uint64_t blueWins() const noexcept { return blue_wins; }
+    [[nodiscard]] std::uint64_t redWins() const noexcept { return red_wins; }
+    /// How many turns each battle lasted
+    [[nodiscard]] const util::Histogram& battleTurns() const noexcept { return battle_turns; }
+
+    [[nodiscard]] const auto& skills() const noexcept { return by_skill; }
+    [[nodiscard]] const auto& entities() const noexcept { return by_entity; }
+    [[nodiscard]] const auto& elements() const noexcept { return by_element; }
+
+private:
+    using EntityKey = std::pair<util::Symbol, util::Symbol>;  // kind, type
+
+    std::uint64_t battles = 0;
+    std::uint64_t blue_wins = 0;
+    std::uint64_t red_wins = 0;
+    util::Histogram battle_turns;
+
+    std::map<std::string, SkillTally, std::less<>> by_skill;
+    std::map<EntityKey, EntityTally> by_entity;
+    std::array<SkillTally, num_elements> by_element = {};
+
+    // for the battle in progress; pointers into the maps above are stable,
+    // so each skill and entity is only looked up by name once per battle
+    struct Participant {
+        const Entity* entity;
+        EntityTally* tally;
+        Team team;
+    };
+    struct KnownSkill {
+        const SkillDetails* details;
+        SkillTally* tally;
+    };
+    const BattleSystem* current = nullptr;
+    std::vector<Participant> participants;
+    std::vector<KnownSkill> known_skills;
+    std::uint64_t turns = 0;
+
+    // the skill being used, which everything until the next one is put down to
+    const Entity* source = nullptr;
+    EntityTally* source_tally = nullptr;
+    SkillTally* skill_tally = nullptr;
+    SkillTally* element_tally = nullptr;
+
+    EntityTally& tallyFor(const Entity& e);
+    SkillTally& tallyFor(const SkillDetails& details);
+};
+
+/// Write `s' out as a JSON string, quotes and all; control characters
+/// become spaces
+void writeJSONString(std::ostream& os, std::string_view s);
+
+
+}
+
+#endif // BATTLE_STATISTICS_H_INCLUDED
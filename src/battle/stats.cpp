@@ -4,12 +4,20 @@
 namespace battle {
 
 
-Stats calculateModifiedStats(Stats s, const std::vector<StatModifier>& mods) noexcept {
-    static constexpr auto num_stat_types =
-        static_cast<unsigned>(StatType::resist);
-    std::array<int, num_stat_types> stat_mult_sum = { 0 };
-    std::array<int, num_elements> resist_mult_sum = { 0 };
+void ModifierSums::accumulate(const StatModifier& m, int amount) noexcept {
+    const bool resist = m.stat == StatType::resist;
+    const auto i = resist ? static_cast<unsigned>(m.resist) : static_cast<unsigned>(m.stat);
+    switch (m.type) {
+    case StatModType::additive:
+        (resist ? resist_add[i] : stat_add[i]) += amount;
+        break;
+    case StatModType::multiplicative:
+        (resist ? resist_mult[i] : stat_mult[i]) += amount;
+        break;
+    }
+}
 
+Stats applyModifierSums(Stats s, const ModifierSums& sums) noexcept {
     auto performMod = [&s](StatType stat, auto modFunc) {
         switch (stat) {
             case StatType::health: modFunc(s.max_health); break;
@@ -26,41 +34,31 @@ Stats calculateModifiedStats(Stats s, const std::vector<StatModifier>& mods) noe
         }
     };
 
-    for (const auto& m : mods) {
-        switch (m.type) {
-        case StatModType::additive:
-            if (m.stat == StatType::resist)
-                s.setResistance(m.resist, s.getResistance(m.resist) + m.modifier);
-            else
-                performMod(m.stat, [&m](auto& stat){ stat += m.modifier; });
-            break;
-
-        case StatModType::multiplicative:
-            if (m.stat == StatType::resist)
-                resist_mult_sum[static_cast<unsigned>(m.resist)] += m.modifier;
-            else
-                stat_mult_sum[static_cast<unsigned>(m.stat)] += m.modifier;
-        break;
-        }
-    }
-
-    for (unsigned i = 0; i < num_stat_types; i++) {
+    // additives come before multiplicatives
+    for (unsigned i = 0; i < ModifierSums::num_stat_types; i++) {
         performMod(static_cast<StatType>(i), [&](auto& stat) {
-            auto mod = stat_mult_sum[i] / 100.0 + 1.0;
-            stat = static_cast<int>(std::round(stat * mod));
+            auto mod = sums.stat_mult[i] / 100.0 + 1.0;
+            stat = static_cast<int>(std::round((stat + sums.stat_add[i]) * mod));
             stat = std::max(stat, 1);  // cannot have less than 1 in a stat
         });
     }
 
     for (unsigned i = 0; i < num_elements; i++) {
         auto e = static_cast<Element>(i);
-        auto r = s.getResistance(e);
-        auto mod = resist_mult_sum[i] / 100.0 + 1.0;
+        auto r = s.getResistance(e) + sums.resist_add[i];
+        auto mod = sums.resist_mult[i] / 100.0 + 1.0;
         s.setResistance(e, static_cast<int>(std::round(r * mod)));
     }
 
     return s;
 }
 
+Stats calculateModifiedStats(Stats s, const std::vector<StatModifier>& mods) noexcept {
+    ModifierSums sums;
+    for (const auto& m : mods)
+        sums.add(m);
+    return applyModifierSums(s, sums);
+}
+
 
 }
@@ -1,7 +1,9 @@
 #ifndef BATTLE_STATS_H_INCLUDED
 #define BATTLE_STATS_H_INCLUDED
 
+#include <algorithm>
 #include <array>
+#include <string>
 #include <vector>
 #include "battle/element.h"
 
@@ -37,6 +39,25 @@ struct Stats {
     std::array<int, num_elements> resist = {};
 };
 
+/// Overall resistance to a hit of each element (as a percentage), once the
+/// element interactions are taken into account; see `effectiveResistances'
+using Resistances = std::array<int, num_elements>;
+
+/// Work out the overall resistances from a stat block's own resistances.
+/// Each is the sum of the resistances that count against that element,
+/// weighted by `element_interactions' (rounded towards zero), and at most
+/// 100: resisting a hit completely shouldn't turn it into healing.
+[[nodiscard]] constexpr Resistances effectiveResistances(const Stats& s) noexcept {
+    Resistances out = {};
+    for (unsigned hit = 0; hit < num_elements; hit++) {
+        int sum = 0;
+        for (unsigned r = 0; r < num_elements; r++)
+            sum += element_interactions[hit][r] * s.resist[r];
+        out[hit] = std::min(sum / 100, 100);
+    }
+    return out;
+}
+
 /// Lists valid "pooled" stats
 enum class Pool {
     Health,  ///< health pool
@@ -91,6 +112,31 @@ struct StatModifier {
     StatModType type;  ///< how to calculate the modification
 };
 
+/// Running totals of a collection of stat modifiers, per stat and element
+///
+/// Modifiers only ever add up, so these are all that applying them needs;
+/// keeping them as modifiers come and go makes applying any number of them
+/// cost the same as applying none.
+struct ModifierSums {
+    static constexpr auto num_stat_types = static_cast<unsigned>(StatType::resist);
+
+    std::array<int, num_stat_types> stat_add = {};
+    std::array<int, num_stat_types> stat_mult = {};
+    std::array<int, num_elements> resist_add = {};
+    std::array<int, num_elements> resist_mult = {};
+
+    /// Count a modifier in
+    void add(const StatModifier& m) noexcept { accumulate(m, m.modifier); }
+    /// Take a modifier back out again
+    void remove(const StatModifier& m) noexcept { accumulate(m, -m.modifier); }
+
+private:
+    void accumulate(const StatModifier& m, int amount) noexcept;
+};
+
+/// Apply summed up stat modifiers to a stat block
+[[nodiscard]] Stats applyModifierSums(Stats s, const ModifierSums& sums) noexcept;
+
 /// Apply a collection of stat modifiers to a stat block
 [[nodiscard]] Stats
 calculateModifiedStats(Stats s, const std::vector<StatModifier>& mods) noexcept;
@@ -1,6 +1,7 @@
 #ifndef BATTLE_STATUSEFFECT_H_INCLUDED
 #define BATTLE_STATUSEFFECT_H_INCLUDED
 
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -10,6 +11,8 @@
 namespace battle {
 
 
+class Entity;
+
 /// The length of a status effect
 enum class EffectDuration {
     Permanent,  ///< lasts for ever, for example food effects; cannot be cleansed
@@ -45,20 +48,21 @@ public:
     /// Get the duration category for the status effect.
     [[nodiscard]] EffectDuration getEffectDuration() const noexcept;
 
-    /// Get the number of turns left for the status effect, if applicable.
-    /// (See getEffectDuration)
-    [[nodiscard]] std::optional<int> getRemainingTurns() const noexcept;
-
-    /// Call at the end of a turn.
-    void endTurn() noexcept;
-
-    /// Returns true if the status effect is still being applied
-    [[nodiscard]] bool isActive() const noexcept;
+    /// Get the number of turns the status effect lasts once applied, if
+    /// applicable (see getEffectDuration). Once it has been applied, ask the
+    /// entity how many are left: see Entity::getRemainingTurns.
+    [[nodiscard]] std::optional<int> getTurns() const noexcept;
 
 private:
+    friend class Entity;
+
     StatusEffectId id;              ///< the type of effect
-    int num_turns_remaining;        ///< the number of turns remaining
+    int num_turns;                  ///< the number of turns it lasts
     std::vector<StatModifier> mods; ///< the stat modifiers in the effect
+
+    /// For a temporary effect that's been applied: the owner's turn count
+    /// (see Entity::processTurnEnd) at which it's no longer in effect
+    std::uint32_t expiry = 0;
 };
 
 
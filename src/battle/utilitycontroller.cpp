@@ -0,0 +1,145 @@
+#include "battle/utilitycontroller.h"
+
+#include <algorithm>
+#include "battle/battleview.h"
+#include "battle/blackboard.h"
+#include "battle/entity.h"
+#include "battle/skill.h"
+#include "battle/skilldetails.h"
+#include "util/trace.h"
+
+namespace battle {
+
+namespace {
+
+    // the odds of a skill that doesn't do damage the usual way are all zero
+    DamageOdds oddsOf(const SkillDetails& details, const Stats& source,
+                      const Entity& target)
+    {
+        const auto skill = damageSkillOf(details);
+        if (!skill)
+            return {};
+        return damageOdds(*skill, source, target.getStats(),
+                          target.getResistance(skill->element));
+    }
+
+    int totalCost(const SkillDetails& details) noexcept {
+        return details.getHealthCost().value_or(0)
+             + details.getManaCost().value_or(0)
+             + details.getTechCost().value_or(0);
+    }
+
+}
+
+UtilityController::UtilityController(Entity& entity)
+    : entity{ entity }
+{
+}
+
+const std::vector<DamageOdds>& UtilityController::oddsAgainst(const Entity& target) {
+    const auto skills = entity.getUsableSkills();
+    auto& table = tables[&target];
+    if (table.odds.size() == skills.total()
+        && table.source_revision == entity.getStatsRevision()
+        && table.target_revision == target.getStatsRevision())
+        return table.odds;
+
+    TRACE_SCOPE("UtilityController::refresh");
+    const auto source = entity.getStats();
+    table.odds.resize(skills.total());
+    for (std::size_t i = 0; i < skills.total(); i++)
+        table.odds[i] = oddsOf(skills[i]->getDetails(), source, target);
+    table.source_revision = entity.getStatsRevision();
+    table.target_revision = target.getStatsRevision();
+    return table.odds;
+}
+
+double UtilityController::value(std::size_t skill, const Entity& target, double scale) {
+    if (target.isDead())
+        return 0.0;
+    const auto& odds = oddsAgainst(target)[skill];
+    const int health = target.get<Pool::Health>();
+    // damage past what would kill them is wasted
+    const double damage = std::min(odds.expected() * scale, static_cast<double>(health));
+    return damage * (1 + kill_weight * odds.killChance(health, scale));
+}
+
+Action UtilityController::go(const BattleView& view) {
+    TRACE_SCOPE("UtilityController::go");
+    const auto skills = entity.getUsableSkills();
+    const auto& enemies = view.board ? view.board->enemies : view.enemies;
+    const auto& allies = view.board ? view.board->allies : view.allies;
+    const Entity* focus = view.board ? view.board->focus : nullptr;
+
+    double best_score = 0.0;
+    const Skill* best_skill = nullptr;
+    const Entity* best_target = nullptr;
+    const auto consider = [&](double score, SkillRef skill, const Entity& target) {
+        if (&target == focus)
+            score *= 1 + focus_weight;
+        if (score > best_score) {
+            best_score = score;
+            best_skill = &*skill;
+            best_target = &target;
+        }
+    };
+
+    for (auto it = skills.begin(); it != skills.end(); ++it) {
+        const auto i = it.position();
+        const auto& details = (*it)->getDetails();
+        const double cost = 1 + cost_weight * totalCost(details);
+
+        switch (details.getSpread()) {
+        case SkillSpread::Self:
+            break;
+
+        case SkillSpread::Single:
+            for (Entity* target : enemies)
+                consider(value(i, *target, 1.0) / cost, *it, *target);
+            break;
+
+        case SkillSpread::SemiAoE: {
+            // the primary target takes the full hit, everyone else 70%
+            double secondary = 0.0;
+            for (Entity* target : enemies)
+                secondary += value(i, *target, 0.7);
+            for (Entity* target : enemies) {
+                const double score = value(i, *target, 1.0)
+                                   + secondary - value(i, *target, 0.7);
+                consider(score / cost, *it, *target);
+            }
+            break;
+        }
+
+        case SkillSpread::AoE: {
+            double score = 0.0;
+            Entity* any = nullptr;
+            for (Entity* target : enemies) {
+                score += value(i, *target, 1.0);
+                if (!any && !target->isDead())
+                    any = target;
+            }
+            if (any)
+                consider(score / cost, *it, *any);
+            break;
+        }
+
+        case SkillSpread::Field: {
+            // hits everyone, so count the damage to friends against it
+            double score = 0.0;
+            for (Entity* target : enemies)
+                score += value(i, *target, 1.0);
+            for (Entity* ally : allies)
+                score -= value(i, *ally, 1.0);
+            consider(score / cost, *it, entity);
+            break;
+        }
+        }
+    }
+
+    if (!best_skill)
+        return action::Defend{};
+    return action::Skill{ *best_skill, *best_target };
+}
+
+}
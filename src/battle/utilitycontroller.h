@@ -0,0 +1,61 @@
+#ifndef BATTLE_UTILITYCONTROLLER_H_INCLUDED
+#define BATTLE_UTILITYCONTROLLER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "battle/controller.h"
+#include "battle/damage.h"
+
+namespace battle {
+
+class Entity;
+
+/// AI controller that picks whatever skill and target look best on paper
+///
+/// Every usable skill is scored against every target by the damage it can
+/// be expected to do (see `damageOdds'), weighted up by the chance of
+/// finishing someone off and down by what it costs to use. The best scoring
+/// pair is chosen; if nothing scores, the entity defends.
+///
+/// Targets come from the team's blackboard when there is one, so only the
+/// living are considered, and the team's focus target is preferred.
+///
+/// The odds only depend on stats, so they're worked out once per target and
+/// kept until either side's stats change; a decision is then mostly lookups.
+class UtilityController : public Controller {
+public:
+    static constexpr bool nest_controller = false;
+
+    /// How much a likely kill is worth, over the damage it does
+    static constexpr double kill_weight = 1.0;
+    /// How much each point of (any) cost counts against a skill
+    static constexpr double cost_weight = 0.02;
+    /// How much more going for the team's focus target is worth
+    static constexpr double focus_weight = 0.25;
+
+    explicit UtilityController(Entity& entity);
+    [[nodiscard]] virtual Action go(const BattleView& view) override;
+
+private:
+    /// The odds of each of the entity's skills against one target
+    struct Table {
+        std::uint32_t source_revision = 0;
+        std::uint32_t target_revision = 0;
+        std::vector<DamageOdds> odds;  ///< indexed as the entity's skills
+    };
+
+    /// The odds against `target', brought up to date if needs be
+    const std::vector<DamageOdds>& oddsAgainst(const Entity& target);
+
+    /// What `skill' is worth against `target', scaled by `scale'
+    [[nodiscard]] double value(std::size_t skill, const Entity& target, double scale);
+
+    Entity& entity; ///< the owning entity
+    std::unordered_map<const Entity*, Table> tables;
+};
+
+}
+
+#endif // BATTLE_UTILITYCONTROLLER_H_INCLUDED
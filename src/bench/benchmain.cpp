@@ -0,0 +1,368 @@
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "battle/battlesystem.h"
+#include "battle/battleview.h"
+#include "battle/entity.h"
+#include "battle/entityloader.h"
+#include "battle/messagesink.h"
+#include "battle/npccontroller.h"
+#include "battle/policycontroller.h"
+#include "battle/skill.h"
+#include "battle/skilldetails.h"
+#include "battle/stats.h"
+#include "battle/statuseffect.h"
+#include "bench/harness.h"
+#include "util/dense.h"
+#include "util/random.h"
+
+namespace {
+
+using battle::Entity;
+using battle::Team;
+using EntityRef = std::shared_ptr<Entity>;
+
+// scale everyone's health up so battles don't end every few turns
+constexpr int health_scale = 1000;
+
+const battle::EntityTemplate& goodTemplate() {
+    static const auto t = battle::loadEntityTemplate("default", "good");
+    return t;
+}
+
+const battle::EntityTemplate& evilTemplate() {
+    static const auto t = battle::loadEntityTemplate("default", "evil");
+    return t;
+}
+
+EntityRef makeEntity(const battle::EntityTemplate& t, std::string type, long n) {
+    auto stats = t.stats;
+    stats.max_health *= health_scale;
+
+    std::vector<battle::Skill> skills;
+    for (auto&& name : t.skills)
+        skills.emplace_back(name);
+
+    auto name = type + " #" + std::to_string(n);
+    auto e = std::make_shared<Entity>(
+        battle::EntityID{ t.kind, t.type, std::move(name) },
+        1, stats, std::move(skills));
+    e->assignController<battle::NPCController>();
+    return e;
+}
+
+// afflict the entity with `count' status effects
+void applyEffects(Entity& e, long count) {
+    battle::MessageLogger discard;
+    for (long i = 0; i < count; i++) {
+        e.applyStatusEffect(discard, i % 2 == 0
+            ? battle::StatusEffectId::AttackBoost
+            : battle::StatusEffectId::DefenseBreak);
+    }
+}
+
+// a team_size vs team_size battle between NPCs
+struct Battle {
+    Battle(long team_size, long effects) {
+        for (long i = 0; i < team_size; i++) {
+            blues.push_back(makeEntity(goodTemplate(), "good", i + 1));
+            reds.push_back(makeEntity(evilTemplate(), "evil", i + 1));
+        }
+        for (auto&& e : blues) applyEffects(*e, effects);
+        for (auto&& e : reds)  applyEffects(*e, effects);
+        system = std::make_unique<battle::BattleSystem>(blues, reds);
+    }
+
+    /// Our own handle on an entity that messages only give out as const
+    Entity& find(const Entity& e) const {
+        for (auto* team : { &blues, &reds })
+            for (auto&& mine : *team)
+                if (mine.get() == &e)
+                    return *mine;
+        throw std::logic_error("Battle::find: not in this battle");
+    }
+
+    std::vector<EntityRef> blues;
+    std::vector<EntityRef> reds;
+    std::unique_ptr<battle::BattleSystem> system;
+};
+
+std::vector<battle::StatModifier> makeMods(long count) {
+    using battle::StatType;
+    using battle::StatModType;
+    std::vector<battle::StatModifier> mods;
+    for (long i = 0; i < count; i++) {
+        const auto type = i % 3 == 0 ? StatModType::multiplicative : StatModType::additive;
+        if (i % 4 == 3) {
+            const auto elem = static_cast<battle::Element>(i % battle::num_elements);
+            mods.emplace_back(elem, 5, type);
+        } else {
+            const auto stat = static_cast<StatType>(i % static_cast<long>(StatType::resist));
+            mods.emplace_back(stat, i % 2 == 0 ? 2 : -1, type);
+        }
+    }
+    return mods;
+}
+
+void benchDoTurn(bench::Runner& runner) {
+    for (long team_size : { 1, 4, 16, 64 }) {
+        for (long effects : { 0, 8 }) {
+            runner.run("BattleSystem::doTurn",
+                       { { "team_size", team_size }, { "effects", effects } },
+                       [=] {
+                auto b = std::make_shared<Battle>(team_size, effects);
+                return [=](bench::State& st) mutable {
+                    while (st.next()) {
+                        auto info = b->system->doTurn();
+
+                        // keep the effect count (roughly) steady, and start
+                        // again if someone managed to win
+                        bool wore_off = false;
+                        for (auto&& m : info.messages)
+                            if (auto se = std::get_if<battle::message::StatusEffect>(&m))
+                                wore_off |= !se->applied;
+                        if (wore_off || b->system->isDone()) {
+                            st.pause();
+                            if (b->system->isDone()) {
+                                b = std::make_shared<Battle>(team_size, effects);
+                            } else {
+                                for (auto&& m : info.messages) {
+                                    auto se = std::get_if<battle::message::StatusEffect>(&m);
+                                    if (se && !se->applied)
+                                        applyEffects(b->find(se->entity), 1);
+                                }
+                            }
+                            st.resume();
+                        }
+                    }
+                };
+            });
+        }
+    }
+}
+
+void benchGetStats(bench::Runner& runner) {
+    for (long effects : { 0, 1, 4, 16, 64 }) {
+        runner.run("Entity::getStats", { { "effects", effects } }, [=] {
+            auto e = makeEntity(goodTemplate(), "good", 1);
+            applyEffects(*e, effects);
+            return [=](bench::State& st) {
+                while (st.next())
+                    bench::doNotOptimize(e->getStats());
+            };
+        });
+    }
+}
+
+void benchCalculateModifiedStats(bench::Runner& runner) {
+    for (long mods : { 0, 2, 8, 32, 128 }) {
+        runner.run("calculateModifiedStats", { { "mods", mods } }, [=] {
+            return [stats = goodTemplate().stats, list = makeMods(mods)](bench::State& st) {
+                while (st.next())
+                    bench::doNotOptimize(battle::calculateModifiedStats(stats, list));
+            };
+        });
+    }
+}
+
+void benchSkillDetails(bench::Runner& runner) {
+    for (long level : { 1, 5 }) {
+        runner.run("SkillDetails::SkillDetails", { { "level", level } }, [=] {
+            return [=](bench::State& st) {
+                while (st.next()) {
+                    battle::SkillDetails details{ "attack", static_cast<int>(level) };
+                    bench::doNotOptimize(details);
+                }
+            };
+        });
+    }
+}
+
+void benchPerform(bench::Runner& runner) {
+    for (long team_size : { 1, 4, 16 }) {
+        for (long effects : { 0, 8 }) {
+            runner.run("SkillDetails::perform",
+                       { { "team_size", team_size }, { "effects", effects } },
+                       [=] {
+                auto b = std::make_shared<Battle>(team_size, effects);
+                auto skill = std::make_shared<battle::Skill>("attack");
+                return [=](bench::State& st) {
+                    auto& source = *b->blues.front();
+                    auto& target = *b->reds.front();
+                    while (st.next()) {
+                        battle::MessageLogger logger;
+                        skill->getDetails().perform(logger, source, target, *b->system);
+                        bench::doNotOptimize(logger);
+
+                        if (target.isDead()) {
+                            st.pause();
+                            target.restore<battle::Pool::Health>(
+                                logger, target.getMax<battle::Pool::Health>());
+                            st.resume();
+                        }
+                    }
+                };
+            });
+        }
+    }
+}
+
+void benchAppendMessage(bench::Runner& runner) {
+    // streamed (to a tally of the messages) or collected into the logger
+    for (long streamed : { 0, 1 }) {
+        for (long messages : { 1, 16, 256 }) {
+            runner.run("MessageLogger::appendMessage",
+                       { { "streamed", streamed }, { "messages", messages } },
+                       [=] {
+                auto e = makeEntity(goodTemplate(), "good", 1);
+                auto counter = std::make_shared<battle::MessageCounter>();
+                return [=](bench::State& st) {
+                    while (st.next()) {
+                        auto logger = streamed
+                            ? battle::MessageLogger{ battle::MessageSink{ *counter } }
+                            : battle::MessageLogger{};
+                        for (long i = 0; i < messages; i++) {
+                            logger.appendMessage(battle::message::PoolChanged{
+                                *e, battle::Pool::Health, 10, 9 });
+                        }
+                        bench::doNotOptimize(logger);
+                        bench::doNotOptimize(*counter);
+                    }
+                };
+            });
+        }
+    }
+}
+
+void benchTeamMembersOf(bench::Runner& runner) {
+    for (long team_size : { 1, 4, 16, 64, 256 }) {
+        runner.run("BattleSystem::teamMembersOf", { { "team_size", team_size } }, [=] {
+            auto b = std::make_shared<Battle>(team_size, 0);
+            return [=](bench::State& st) {
+                while (st.next())
+                    bench::doNotOptimize(b->system->teamMembersOf(Team::Red));
+            };
+        });
+    }
+}
+
+void benchRandom(bench::Runner& runner) {
+    runner.run("util::random", { { "int_max", 100 } }, [] {
+        return [](bench::State& st) {
+            while (st.next())
+                bench::doNotOptimize(util::random(1L, 100L));
+        };
+    });
+    runner.run("util::random", { { "real", 1 } }, [] {
+        return [](bench::State& st) {
+            while (st.next())
+                bench::doNotOptimize(util::random(0.8, 1.2));
+        };
+    });
+    for (long size : { 4, 64 }) {
+        runner.run("util::random", { { "container_size", size } }, [=] {
+            return [v = std::vector<long>(static_cast<std::size_t>(size))](bench::State& st) {
+                while (st.next())
+                    bench::doNotOptimize(util::random(v));
+            };
+        });
+    }
+}
+
+void benchPolicy(bench::Runner& runner) {
+    using util::DenseLayer;
+    for (long width : { 64, 256 }) {
+        for (long int8 : { 0, 1 }) {
+            runner.run("DenseLayer::apply", { { "width", width }, { "int8", int8 } }, [=] {
+                const auto n = static_cast<std::size_t>(width);
+                std::vector<float> weights(n * n);
+                for (auto& w : weights)
+                    w = static_cast<float>(util::random(-1.0, 1.0));
+                auto layer = std::make_shared<DenseLayer>(n, n, weights, std::vector<float>(n),
+                    DenseLayer::Activation::Relu,
+                    int8 ? DenseLayer::Precision::Int8 : DenseLayer::Precision::Float);
+                return [=, in = std::vector<float>(n, 0.5f), out = std::vector<float>(n),
+                        ws = DenseLayer::Workspace{}](bench::State& st) mutable {
+                    while (st.next()) {
+                        layer->apply(in.data(), out.data(), ws);
+                        bench::doNotOptimize(out);
+                    }
+                };
+            });
+        }
+    }
+
+    for (long team_size : { 1, 4, 16 }) {
+        runner.run("PolicyController::go", { { "team_size", team_size } }, [=] {
+            auto b = std::make_shared<Battle>(team_size, 0);
+            auto policy = battle::loadPolicy("default");
+            auto& e = *b->blues.front();
+            e.assignController<battle::PolicyController>(policy);
+            return [=, &e](bench::State& st) {
+                const battle::BattleView view{
+                    b->system->teamMembersOf(Team::Blue),
+                    b->system->teamMembersOf(Team::Red),
+                    &b->system->blackboard(Team::Blue)
+                };
+                while (st.next())
+                    bench::doNotOptimize(e.getController().go(view));
+            };
+        });
+    }
+}
+
+int usage(const char* name) {
+    std::cerr << "usage: " << name
+              << " [--filter TEXT] [--min-time MS] [--repetitions N] [--seed N]\n"
+              << "Writes one JSON object per benchmark to stdout.\n";
+    return 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    long min_time = 200;
+    int repetitions = 5;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            else if (arg == "--filter")
+                filter = argv[++i];
+            else if (arg == "--min-time")
+                min_time = std::stol(argv[++i]);
+            else if (arg == "--repetitions")
+                repetitions = std::stoi(argv[++i]);
+            else if (arg == "--seed")
+                util::seed(static_cast<unsigned>(std::stoul(argv[++i])));
+            else
+                return usage(argv[0]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return usage(argv[0]);
+    }
+
+    bench::Runner runner{ std::cout, filter, std::chrono::milliseconds{ min_time }, repetitions };
+
+    benchDoTurn(runner);
+    benchGetStats(runner);
+    benchCalculateModifiedStats(runner);
+    benchSkillDetails(runner);
+    benchPerform(runner);
+    benchAppendMessage(runner);
+    benchTeamMembersOf(runner);
+    benchRandom(runner);
+    benchPolicy(runner);
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "bench/harness.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace bench {
+
+
+Runner::Runner(std::ostream& out, std::string filter,
+               std::chrono::milliseconds min_time, int repetitions)
+    : out{ out }
+    , filter{ std::move(filter) }
+    , min_time{ min_time }
+    , repetitions{ std::max(repetitions, 1) }
+{
+}
+
+void Runner::run(const std::string& name, const std::vector<Param>& params,
+                 const std::function<Fixture()>& make)
+{
+    std::string id = name;
+    for (auto&& [key, value] : params)
+        id += "/" + key + ":" + std::to_string(value);
+    if (id.find(filter) == std::string::npos)
+        return;
+    std::cerr << id << "...\n";
+
+    // work out how many iterations we need to fill the minimum time,
+    // growing the count until one run takes long enough
+    std::size_t iterations = 1;
+    while (true) {
+        auto fixture = make();
+        State state{ iterations };
+        fixture(state);
+        if (state.time() >= min_time || iterations >= (std::size_t{1} << 40))
+            break;
+
+        using namespace std::chrono;
+        const auto taken = std::max<long long>(
+            duration_cast<nanoseconds>(state.time()).count(), 1);
+        const auto wanted = duration_cast<nanoseconds>(min_time).count();
+        // overshoot a little, but don't grow too fast on a noisy first run
+        const auto scale = std::min(1.2 * wanted / taken, 100.0);
+        iterations = std::max(iterations + 1,
+                              static_cast<std::size_t>(iterations * scale));
+    }
+
+    std::vector<double> ns_per_op;
+    for (int i = 0; i < repetitions; i++) {
+        auto fixture = make();
+        State state{ iterations };
+        fixture(state);
+        const auto ns = std::chrono::duration<double, std::nano>(state.time()).count();
+        ns_per_op.push_back(ns / static_cast<double>(iterations));
+    }
+    std::sort(std::begin(ns_per_op), std::end(ns_per_op));
+
+    out << "{\"name\":\"" << name << "\",\"params\":{";
+    bool first = true;
+    for (auto&& [key, value] : params) {
+        if (!first) out << ",";
+        first = false;
+        out << "\"" << key << "\":" << value;
+    }
+    out << "},\"iterations\":" << iterations
+        << ",\"repetitions\":" << repetitions
+        << ",\"ns_per_op\":" << ns_per_op[ns_per_op.size() / 2]
+        << ",\"min_ns_per_op\":" << ns_per_op.front()
+        << ",\"max_ns_per_op\":" << ns_per_op.back()
+        << "}" << std::endl;
+}
+
+
+}
@@ -0,0 +1,103 @@
+#ifndef BENCH_HARNESS_H_INCLUDED
+#define BENCH_HARNESS_H_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+
+/// Stop the compiler from optimising away the computation of `value'
+template <typename T>
+inline void doNotOptimize(const T& value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static const volatile void* sink;
+    sink = &value;
+#endif
+}
+
+/// The timing state for a single run of a fixture
+///
+/// A fixture loops on `next()`, doing one operation per iteration.
+/// Any setup that shouldn't count towards the time (e.g. restarting a
+/// finished battle) goes between `pause()` and `resume()`.
+class State {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit State(std::size_t iterations) noexcept
+        : remaining{ iterations }
+    {}
+
+    /// Should we do another iteration?
+    bool next() noexcept {
+        if (remaining == 0) {
+            stop();
+            return false;
+        }
+        if (!running)
+            resume();
+        remaining--;
+        return true;
+    }
+
+    void pause() noexcept {
+        elapsed += Clock::now() - start;
+        running = false;
+    }
+
+    void resume() noexcept {
+        running = true;
+        start = Clock::now();
+    }
+
+    /// Total time spent in the timed sections
+    [[nodiscard]] Clock::duration time() const noexcept { return elapsed; }
+
+private:
+    void stop() noexcept {
+        if (running)
+            pause();
+    }
+
+    std::size_t remaining;
+    bool running = false;
+    Clock::time_point start = {};
+    Clock::duration elapsed = {};
+};
+
+/// A named parameter for a fixture, e.g. { "team_size", 4 }
+using Param = std::pair<std::string, long>;
+
+/// Runs fixtures and writes one JSON object per result line
+class Runner {
+public:
+    using Fixture = std::function<void(State&)>;
+
+    Runner(std::ostream& out, std::string filter,
+           std::chrono::milliseconds min_time, int repetitions);
+
+    /// Time a fixture, with the given parameters, and report the result.
+    /// `make' is called once per repetition to set up a fresh fixture,
+    /// which is then run for however many iterations are required.
+    void run(const std::string& name, const std::vector<Param>& params,
+             const std::function<Fixture()>& make);
+
+private:
+    std::ostream& out;
+    std::string filter;
+    std::chrono::milliseconds min_time;
+    int repetitions;
+};
+
+
+}
+
+#endif // BENCH_HARNESS_H_INCLUDED
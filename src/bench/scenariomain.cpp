@@ -0,0 +1,254 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "battle/battlesystem.h"
+#include "battle/entity.h"
+#include "battle/luamemory.h"
+#include "battle/npcside.h"
+#include "battle/statistics.h"
+#include "util/histogram.h"
+#include "util/random.h"
+
+namespace {
+
+using EntityRef = std::shared_ptr<battle::Entity>;
+
+// the lua collector gets more time between battles than between turns
+constexpr std::size_t battle_collect_kb = 1024;
+
+using Side = battle::NPCSide;
+
+/// A battle to play over and over, at one or more team sizes
+struct Scenario {
+    std::string name;
+    Side player = { "default", "good" };
+    Side enemy = { "default", "evil" };
+    std::vector<long> team_sizes = {};
+    long battles = 100;  ///< per team size
+    long max_turns = 10000;
+    unsigned seed = 1;
+};
+
+std::string scenarioPath(const std::string& name) {
+    return "./data/scenario/" + name + ".scenario";
+}
+
+// the scenarios to run when none are named: those listed in the index,
+// one name per line, smallest first
+std::vector<std::string> loadIndex() {
+    const std::string path = "./data/scenario/index";
+    std::ifstream in{ path };
+    if (!in) throw std::invalid_argument("couldn't open '" + path + "'.");
+
+    std::vector<std::string> names;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream iss{ line.substr(0, line.find('#')) };
+        for (std::string name; iss >> name; )
+            names.push_back(name);
+    }
+    return names;
+}
+
+// read a scenario file, of lines like so:
+//     player default good     # entity kind and type for each side
+//     enemy default evil
+//     ai enemy utility        # the controller for everyone on a side
+//     team_size 1 4 16        # one run per size, for a scaling curve
+//     battles 100             # per team size
+//     max_turns 10000
+//     seed 1
+Scenario loadScenario(const std::string& name) {
+    const std::string path = scenarioPath(name);
+    std::ifstream in{ path };
+    if (!in) throw std::invalid_argument("couldn't open '" + path + "'.");
+
+    Scenario s;
+    s.name = name;
+    std::string line;
+    for (int num = 1; std::getline(in, line); num++) {
+        const auto fail = [&](const std::string& what) {
+            return std::invalid_argument(path + ":" + std::to_string(num) + ": " + what);
+        };
+
+        std::istringstream iss{ line.substr(0, line.find('#')) };
+        std::string key;
+        if (!(iss >> key))
+            continue;
+
+        if (key == "player") iss >> s.player.kind >> s.player.type;
+        else if (key == "enemy") iss >> s.enemy.kind >> s.enemy.type;
+        else if (key == "battles") iss >> s.battles;
+        else if (key == "max_turns") iss >> s.max_turns;
+        else if (key == "seed") iss >> s.seed;
+        else if (key == "ai") {
+            std::string which, ai;
+            iss >> which >> ai;
+            if (which != "player" && which != "enemy")
+                throw fail("expected 'player' or 'enemy'");
+            try {
+                (which == "player" ? s.player : s.enemy).ai = battle::checkAI(ai);
+            } catch (const std::invalid_argument& e) {
+                throw fail(e.what());
+            }
+        } else if (key == "team_size") {
+            for (long n; iss >> n; )
+                s.team_sizes.push_back(n);
+            if (!iss.eof())
+                throw fail("team sizes must be whole numbers");
+            continue;
+        } else
+            throw fail("unknown key '" + key + "'");
+
+        if (iss.fail())
+            throw fail("bad value for '" + key + "'");
+    }
+
+    if (s.team_sizes.empty())
+        s.team_sizes.push_back(1);
+    for (long n : s.team_sizes)
+        if (n < 1)
+            throw std::invalid_argument(path + ": team sizes must be at least 1");
+    if (s.battles < 1)
+        throw std::invalid_argument(path + ": need at least one battle");
+
+    s.player.load();
+    s.enemy.load();
+    return s;
+}
+
+// the most memory the process has had resident since the last reset, in KB;
+// Linux only, as it comes from /proc
+std::optional<long> peakResidentKB() {
+#ifdef __linux__
+    std::ifstream status{ "/proc/self/status" };
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0)
+            return std::stol(line.substr(6));
+    }
+#endif
+    return std::nullopt;
+}
+
+// start the peak over from what's resident now, so that it's the peak of
+// the next scenario alone (not possible everywhere; then it's the peak of
+// everything so far, which is why the index goes smallest first)
+void resetPeakResident() {
+#ifdef __linux__
+    std::ofstream clear{ "/proc/self/clear_refs" };
+    clear << "5";
+#endif
+}
+
+// play one scenario at one team size, and report on it as a line of JSON
+void run(const Scenario& s, long team_size, std::ostream& out) {
+    std::cerr << s.name << "/team_size:" << team_size << "...\n";
+    util::seed(s.seed);
+    resetPeakResident();
+
+    battle::Statistics stats;
+    util::Histogram turn_ns;
+    using Clock = std::chrono::steady_clock;
+
+    const auto start = Clock::now();
+    for (long b = 0; b < s.battles; b++) {
+        std::vector<EntityRef> blues, reds;
+        for (long n = 1; n <= team_size; n++) {
+            blues.push_back(s.player.makeEntity(n));
+            reds.push_back(s.enemy.makeEntity(n));
+        }
+        battle::BattleSystem system{ blues, reds };
+        system.setMessageSink(stats);
+
+        stats.beginBattle(system);
+        for (long turn = 0; turn < s.max_turns && !system.isDone(); turn++) {
+            const auto before = Clock::now();
+            (void)system.doTurn();
+            const auto taken = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - before);
+            turn_ns.add(static_cast<std::uint64_t>(taken.count()));
+        }
+        stats.endBattle(system);
+        battle::stepLuaCollector(battle_collect_kb);
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    const auto seconds = elapsed.count();
+    const auto rate = [seconds](double n) { return seconds > 0 ? n / seconds : 0.0; };
+    const auto turns = turn_ns.count();
+    const auto peak = peakResidentKB();
+
+    out << "{\"scenario\":";
+    battle::writeJSONString(out, s.name);
+    out << ",\"team_size\":" << team_size
+        << ",\"combatants\":" << 2 * team_size
+        << ",\"seed\":" << s.seed
+        << ",\"battles\":" << s.battles
+        << ",\"turns\":" << turns
+        << ",\"blue_wins\":" << stats.blueWins()
+        << ",\"seconds\":" << seconds
+        << ",\"battles_per_sec\":" << rate(static_cast<double>(s.battles))
+        << ",\"turns_per_sec\":" << rate(static_cast<double>(turns))
+        << ",\"turn_ns\":{\"p50\":" << turn_ns.percentile(50)
+        << ",\"p99\":" << turn_ns.percentile(99)
+        << ",\"max\":" << turn_ns.max() << "}"
+        << ",\"peak_rss_kb\":";
+    if (peak)
+        out << *peak;
+    else
+        out << "null";
+    out << "}" << std::endl;
+}
+
+int usage(const char* name) {
+    std::cerr << "usage: " << name << " [--filter TEXT] [SCENARIO...]\n"
+              << "Plays each scenario in data/scenario (or just those named) with its\n"
+              << "fixed seed, and writes one JSON object per scenario and team size\n"
+              << "to stdout: battles and turns per second, turn latency percentiles,\n"
+              << "and peak resident memory.\n";
+    return 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (!arg.empty() && arg[0] == '-')
+            return usage(argv[0]);
+        else
+            names.emplace_back(arg);
+    }
+
+    try {
+        if (names.empty())
+            names = loadIndex();
+        for (auto&& name : names) {
+            if (name.find(filter) == std::string::npos)
+                continue;
+            const auto scenario = loadScenario(name);
+            for (long team_size : scenario.team_sizes)
+                run(scenario, team_size, std::cout);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
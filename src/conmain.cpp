@@ -1,22 +1,29 @@
 #include <algorithm>
 #include <cstdlib>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <locale>
+#include <map>
 #include <memory>
 #include <numeric>
 #include <sstream>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
 
 #include "battle/battlesystem.h"
 #include "battle/entity.h"
+#include "battle/entityloader.h"
+#include "battle/logsink.h"
 #include "battle/npccontroller.h"
 #include "battle/playercontroller.h"
-#include "util/overload.h"
+#include "util/logwriter.h"
+#include "util/random.h"
+#include "util/symbol.h"
 
 template <typename T, typename F>
 T getInput(F is_valid, std::string_view errormsg = "Invalid input!\n> ") {
@@ -47,71 +54,17 @@ T getInput(std::string_view errormsg = "Invalid input!\n> ") {
     return getInput<T>([](auto){ return true; }, errormsg);
 }
 
-std::shared_ptr<battle::Entity> loadEntity(battle::EntityID id) {
-    using namespace battle;
-    std::string path = "./data/entity/" + id.kind + "." + id.type + ".entity";
-    std::ifstream in { path };
-    if (!in) throw std::invalid_argument("couldn't open '" + path + "'.");
-
-    Stats stats;
-    std::vector<Skill> skills;
-
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty())
-            continue;
-
-        std::istringstream iss{ line };
-        std::string stat;
-        iss >> stat;
-
-        if (stat.empty() || stat[0] == '#') continue; // ignore comments
-        else if (stat == "max_health") iss >> stats.max_health;
-        else if (stat == "max_mana") iss >> stats.max_mana;
-        else if (stat == "max_tech") iss >> stats.max_tech;
-        else if (stat == "p_atk") iss >> stats.p_atk;
-        else if (stat == "p_def") iss >> stats.p_def;
-        else if (stat == "m_atk") iss >> stats.m_atk;
-        else if (stat == "m_def") iss >> stats.m_def;
-        else if (stat == "skill") iss >> stats.skill;
-        else if (stat == "evade") iss >> stats.evade;
-        else if (stat == "react") iss >> stats.react;
-        else if (stat == "ability") {
-            std::string skill_name;
-            std::getline(iss >> std::ws, skill_name);
-            skills.emplace_back(skill_name);
-        } else
-            throw std::invalid_argument(id.name + ": unknown key '" + stat + "'.");
-    }
-
-    auto test_stat = [](auto stat, std::string name) {
-        if (stat <= 0)
-            throw std::invalid_argument("bad value for '" + name + "'.");
-    };
-    test_stat(stats.max_health, "max_health");
-    test_stat(stats.max_mana, "max_mana");
-    test_stat(stats.max_tech, "max_tech");
-    test_stat(stats.p_atk, "p_atk");
-    test_stat(stats.p_def, "p_def");
-    test_stat(stats.m_atk, "m_atk");
-    test_stat(stats.m_def, "m_def");
-    test_stat(stats.skill, "skill");
-    test_stat(stats.evade, "evade");
-    test_stat(stats.react, "react");
-
-    return std::make_shared<Entity>(id, 1, stats, std::move(skills));
-}
-
 auto generateTeams() {
     using battle::Team;
 
-    std::unordered_map<std::string, int> seen_ids;
+    using Key = std::pair<util::Symbol, util::Symbol>;  // kind, type
+    std::map<Key, int> seen_ids;
 
-    auto gen_id = [](std::string&& kind, std::string&& type, int count, bool do_1) {
-        auto name = kind + " " + type;
+    auto gen_id = [](util::Symbol kind, util::Symbol type, int count, bool do_1) {
+        auto name = kind.str() + " " + type.str();
         if (do_1 || count > 1)
             name += " #" + std::to_string(count);
-        return battle::EntityID { std::move(kind), std::move(type), std::move(name) };
+        return battle::EntityID { kind, type, std::move(name) };
     };
 
     // can't just use getInput here: should really fix that
@@ -128,13 +81,12 @@ auto generateTeams() {
             std::getline(std::cin, line);
             std::istringstream iss { line };
             iss >> kind >> type;
-            std::string path = "./data/entity/" + kind + "." + type + ".entity";
-            std::ifstream in { path };
+            std::ifstream in { battle::entityPath(kind, type) };
             if (!in) {
                 std::cout << "Unknown entity [" << kind << ", " << type << "]. "
                           << "Try again: ";
             } else
-                return std::make_pair(kind, type);
+                return std::make_pair(util::Symbol{ kind }, util::Symbol{ type });
         }
     };
 
@@ -145,8 +97,8 @@ auto generateTeams() {
     for (int i = 0; i < players; i++) {
         std::cout << "Player #" << i + 1 << ": ";
         auto [kind, type] = get_kind_type();
-        int count = ++seen_ids[kind + "\0" + type];
-        blue_ids.push_back(gen_id(std::move(kind), std::move(type), count, false));
+        int count = ++seen_ids[Key{ kind, type }];
+        blue_ids.push_back(gen_id(kind, type, count, false));
     }
 
     std::cout << "\n";
@@ -158,22 +110,22 @@ auto generateTeams() {
     for (int i = 0; i < enemies; i++) {
         std::cout << "Enemy #" << i + 1 << ": ";
         auto [kind, type] = get_kind_type();
-        int count = ++seen_ids[kind + "\0" + type];
-        red_ids.push_back(gen_id(std::move(kind), std::move(type), count, false));
+        int count = ++seen_ids[Key{ kind, type }];
+        red_ids.push_back(gen_id(kind, type, count, false));
     }
 
     // converts an EntityID to an Entity; NOTE destroys `id' (assume xvalue)
     auto to_entity = [&seen_ids,gen_id](Team team) {
         return [&seen_ids,gen_id,team](battle::EntityID& id) {
             // catch those ids we missed adding numbers to in the first insertion
-            auto test_str = id.kind + "\0" + id.type;
-            if (seen_ids[test_str] > 1) {
-                id = gen_id(std::move(id.kind), std::move(id.type), 1, true);
-                seen_ids[test_str] = 0; // but we only want to change the first one
+            const Key key{ id.kind, id.type };
+            if (seen_ids[key] > 1) {
+                id = gen_id(id.kind, id.type, 1, true);
+                seen_ids[key] = 0; // but we only want to change the first one
             }
 
             // set controllers (if applicable)
-            auto e = loadEntity(std::move(id));
+            auto e = battle::loadEntity(std::move(id));
             if (team == Team::Blue)
                 e->assignController<battle::PlayerController>();
             else
@@ -196,31 +148,31 @@ auto generateTeams() {
     return std::make_pair(blue_entities, red_entities);
 }
 
-void drawEntity(const battle::Entity& entity) {
+// (to the log, or straight to the console in the menus)
+template <typename Out>
+void drawEntity(Out& out, const battle::Entity& entity) {
     constexpr auto HP = battle::Pool::Health;
     constexpr auto MP = battle::Pool::Mana;
     constexpr auto TP = battle::Pool::Tech;
 
-    const auto HP_str = to_string(HP) + ": ";
-    const auto MP_str = to_string(MP) + ": ";
-    const auto TP_str = to_string(TP) + ": ";
-
-    std::cout << "\"" << entity.getID().name << "\" "
-              << "level " << entity.getLevel() << " | "
-              << HP_str << entity.get<HP>() << "/" << entity.getMax<HP>() << " | "
-              << MP_str << entity.get<MP>() << "/" << entity.getMax<MP>() << " | "
-              << TP_str << entity.get<TP>() << "/" << entity.getMax<TP>() << "\n";
+    out << '"' << entity.getID().name << "\" "
+        << "level " << entity.getLevel() << " | "
+        << "HP: " << entity.get<HP>() << '/' << entity.getMax<HP>() << " | "
+        << "MP: " << entity.get<MP>() << '/' << entity.getMax<MP>() << " | "
+        << "TP: " << entity.get<TP>() << '/' << entity.getMax<TP>() << '\n';
 }
 
-void drawTeams(const battle::BattleSystem& system) {
+void drawTeams(util::LogBuffer& out, const battle::BattleSystem& system) {
     using battle::Team;
-    std::cout << "\nBlue team:\n" << std::string(60, '=') << "\n";
+    constexpr std::string_view rule =
+        "============================================================\n";
+    out << "\nBlue team:\n" << rule;
     for (auto entity : system.teamMembersOf(Team::Blue))
-        drawEntity(*entity);
-    std::cout << "\nRed team:\n" << std::string(60, '=') << "\n";
+        drawEntity(out, *entity);
+    out << "\nRed team:\n" << rule;
     for (auto entity : system.teamMembersOf(Team::Red))
-        drawEntity(*entity);
-    std::cout << "\n";
+        drawEntity(out, *entity);
+    out << '\n';
 }
 
 // TODO: would probably split up the options placing
@@ -324,13 +276,13 @@ void handleUserChoice(battle::PlayerController& controller,
             std::cout << "Red team:\n";
             for (auto&& target : red_team) {
                 std::cout << "  " << ++i << ". ";
-                drawEntity(*target);
+                drawEntity(std::cout, *target);
             }
             unsigned splitpoint = i;
             std::cout << "Blue Team:\n";
             for (auto&& target : blue_team) {
                 std::cout << "  " << ++i << ". ";
-                drawEntity(*target);
+                drawEntity(std::cout, *target);
             }
             std::cout << "> ";
 
@@ -376,7 +328,7 @@ void handleUserChoice(battle::PlayerController& controller,
             std::cout << "Applied status effects:\n";
             for (auto&& se : effects) {
                 std::cout << "  - " << se.getName();
-                auto duration = se.getRemainingTurns();
+                auto duration = e.getRemainingTurns(se);
                 if (duration)
                     std::cout << " (" << *duration << " turns remaining)";
                 std::cout << "\n";
@@ -405,80 +357,55 @@ void handleUserChoice(battle::PlayerController& controller,
             controller.choose(fn());
 }
 
-void printMessage(const battle::Message& m) {
-    using namespace battle::message;
-    std::visit(util::overload{
-        [](const SkillUsed& su) {
-            std::cout << su.source.getID().name << " used "
-                      << su.skill->getDetails().getName() << " on "
-                      << su.target.getID().name << "!\n";
-        },
-        [](const Miss& m) {
-            std::cout << m.entity.getID().name << " avoided the attack!\n";
-        },
-        [](const Critical& c) {
-            std::cout << c.entity.getID().name << " took a critical hit!\n";
-        },
-        [](const PoolChanged& pc) {
-            const auto name = pc.entity.getID().name;
-            const auto diff = pc.new_value - pc.old_value;
-            std::string poolname = to_string(pc.pool);
-            if (diff < 0) {
-                std::cout << name << " lost "
-                          << -diff << " " << poolname << "!\n";
-            } else if (diff > 0) {
-                std::cout << name << " restored "
-                          << diff << " " << poolname << "!\n";
-            } else {
-                std::cout << name << "'s "
-                          << poolname << " remained unchanged.\n";
-            }
-        },
-        [](const StatusEffect& e) {
-            const auto name = e.entity.getID().name;
-            if (e.applied) {
-                std::cout << name << " is now affected by "
-                          << e.effect << "!\n";
-            } else {
-                std::cout << name << "'s "
-                          << e.effect << " wore off.\n";
-            }
-        },
-        [](const Defended& d) {
-            std::cout << d.entity.getID().name << " is defending!\n";
-        },
-        [](const Fled& f) {
-            std::cout << f.entity.getID().name << " attempted to flee";
-            if (f.succeeded)
-                std::cout << ", and succeeded!\n";
+int main(int argc, char* argv[]) {
+    // a fixed seed makes a run reproducible: feeding the same input to two
+    // builds (say, Lua 5.3 and LuaJIT) should give identical transcripts
+    const auto usage = [&] {
+        std::cerr << "usage: " << argv[0] << " [--seed N]\n";
+        return 1;
+    };
+    try {
+        for (int i = 1; i < argc; i++) {
+            if (std::string_view{ argv[i] } == "--seed" && i + 1 < argc)
+                util::seed(static_cast<unsigned>(std::stoul(argv[++i])));
             else
-                std::cout << "... but failed.";
-        },
-        [](const Died& d) {
-            std::cout << d.entity.getID().name << " died!\n";
-        },
-        [](const Notification& n) {
-            std::cout << n.message << "\n";
+                return usage();
         }
-    }, m);
-}
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return usage();
+    }
 
-int main() {
     std::cout << "Welcome to the wonderful battle simulator!\n\n";
 
     auto system = std::make_from_tuple<battle::BattleSystem>(generateTeams());
-    drawTeams(system);
+
+    // the battle's text is formatted into `log' and written out in the
+    // background; the menus still go straight to std::cout, so the log has
+    // to be caught up before each of them
+    util::LogWriter writer{ std::cout };
+    util::LogBuffer log{ writer };
+    const auto catchUp = [&] {
+        log.flush();
+        writer.flush();
+    };
+
+    drawTeams(log, system);
+
+    battle::LogSink printer{ log };
+    system.setMessageSink(printer);
 
     while (!system.isDone()) {
         battle::TurnInfo info = system.doTurn();
-        for (const auto& m : info.messages)
-            printMessage(m);
-        if (info.need_user_input)
+        if (info.need_user_input) {
+            catchUp();
             handleUserChoice(*info.controller, system);
-        std::cout << "\n";
+        }
+        log << '\n';
+        log.commit();
     }
 
-    std::cout << "Game over! Come back next time!\n" << std::flush;
+    log << "Game over! Come back next time!\n";
 
     return 0;
 }
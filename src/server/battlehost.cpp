@@ -0,0 +1,338 @@
+#include "server/battlehost.h"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "battle/entity.h"
+#include "battle/npccontroller.h"
+#include "battle/playercontroller.h"
+#include "battle/skill.h"
+
+namespace server {
+
+using protocol::FrameType;
+using protocol::MessageTag;
+
+namespace {
+    // a battle gets this many turns (or messages) at a time before it has to
+    // make way for the other battles on the same worker
+    constexpr int turn_budget = 256;
+    constexpr std::size_t message_budget = 0x8000;
+
+    std::uint8_t indexOf(const std::vector<std::shared_ptr<battle::Entity>>& combatants,
+                         const battle::Entity& e)
+    {
+        auto it = std::find_if(combatants.begin(), combatants.end(),
+                               [&e](auto&& c){ return c.get() == &e; });
+        return static_cast<std::uint8_t>(it - combatants.begin());
+    }
+
+}
+
+
+/// Writes a battle's messages straight into the Turn frame being built
+struct BattleHost::Encoder {
+    const std::vector<EntityRef>& combatants;
+    std::vector<unsigned char>* out = nullptr;  ///< set for the length of `advance'
+    std::size_t count = 0;
+
+    std::uint8_t index(const battle::Entity& e) const noexcept {
+        return indexOf(combatants, e);
+    }
+
+    protocol::Writer begin(MessageTag tag) noexcept {
+        count++;
+        protocol::Writer w{ *out };
+        w.u8(static_cast<std::uint8_t>(tag));
+        return w;
+    }
+
+    void operator()(const battle::message::SkillUsed& su) noexcept {
+        auto w = begin(MessageTag::SkillUsed);
+        w.u8(index(su.source));
+        w.u8(index(su.target));
+        w.str8(su.skill->getDetails().getName());
+    }
+
+    void operator()(const battle::message::Miss& m) noexcept {
+        begin(MessageTag::Miss).u8(index(m.entity));
+    }
+
+    void operator()(const battle::message::Critical& c) noexcept {
+        begin(MessageTag::Critical).u8(index(c.entity));
+    }
+
+    void operator()(const battle::message::PoolChanged& pc) noexcept {
+        auto w = begin(MessageTag::PoolChanged);
+        w.u8(index(pc.entity));
+        w.u8(static_cast<std::uint8_t>(pc.pool));
+        w.i32(pc.old_value);
+        w.i32(pc.new_value);
+    }
+
+    void operator()(const battle::message::StatusEffect& se) noexcept {
+        auto w = begin(MessageTag::StatusEffect);
+        w.u8(index(se.entity));
+        w.u8(se.applied);
+        w.str8(se.effect);
+    }
+
+    void operator()(const battle::message::Defended& d) noexcept {
+        begin(MessageTag::Defended).u8(index(d.entity));
+    }
+
+    void operator()(const battle::message::Fled& f) noexcept {
+        auto w = begin(MessageTag::Fled);
+        w.u8(index(f.entity));
+        w.u8(f.succeeded);
+    }
+
+    void operator()(const battle::message::Died& d) noexcept {
+        begin(MessageTag::Died).u8(index(d.entity));
+    }
+
+    void operator()(const battle::message::Notification& n) noexcept {
+        begin(MessageTag::Notification).str16(n.message);
+    }
+};
+
+void BattleHost::EncoderDeleter::operator()(Encoder* e) const noexcept {
+    delete e;
+}
+
+
+const battle::EntityTemplate& BattleHost::entityTemplate(const CreateRequest::Member& m) {
+    auto& [kind, type] = m;
+    // don't let clients wander around the file system
+    const auto bad = [](const std::string& s) {
+        return s.empty() || s.find_first_of("/\\") != std::string::npos;
+    };
+    if (bad(kind) || bad(type))
+        throw std::invalid_argument("bad entity [" + kind + ", " + type + "]");
+
+    // '/' can't appear in either part, so this is unambiguous
+    auto key = kind + "/" + type;
+    auto it = templates.find(key);
+    if (it == templates.end())
+        it = templates.emplace(std::move(key), battle::loadEntityTemplate(kind, type)).first;
+    return it->second;
+}
+
+BattleHost::EntityRef BattleHost::makeEntity(const CreateRequest::Member& m, int count) {
+    const auto& t = entityTemplate(m);
+
+    std::vector<battle::Skill> skills;
+    for (auto&& name : t.skills)
+        skills.emplace_back(name);
+
+    auto name = m.first + " " + m.second + " #" + std::to_string(count);
+    return std::make_shared<battle::Entity>(
+        battle::EntityID{ t.kind, t.type, std::move(name) },
+        1, t.stats, std::move(skills));
+}
+
+Progress BattleHost::create(std::uint32_t id, const CreateRequest& req,
+                            std::vector<unsigned char>& out)
+{
+    Battle b;
+    std::vector<EntityRef> blues;
+    std::vector<EntityRef> reds;
+    try {
+        std::unordered_map<std::string, int> seen;
+        for (auto&& m : req.players) {
+            auto e = makeEntity(m, ++seen[m.first + "/" + m.second]);
+            e->assignController<battle::PlayerController>();
+            blues.push_back(e);
+        }
+        for (auto&& m : req.enemies) {
+            auto e = makeEntity(m, ++seen[m.first + "/" + m.second]);
+            e->assignController<battle::NPCController>();
+            reds.push_back(e);
+        }
+        b.system = std::make_unique<battle::BattleSystem>(blues, reds);
+    } catch (const std::exception& e) {
+        return fail(req.tag, e.what(), out);
+    }
+
+    b.combatants = blues;
+    b.combatants.insert(b.combatants.end(), reds.begin(), reds.end());
+
+    protocol::Writer w{ out };
+    w.begin(FrameType::Created);
+    w.u32(req.tag);
+    w.u32(id);
+    w.u8(static_cast<std::uint8_t>(b.combatants.size()));
+    for (std::size_t i = 0; i < b.combatants.size(); i++) {
+        const auto team = i < blues.size() ? battle::Team::Blue : battle::Team::Red;
+        w.u8(static_cast<std::uint8_t>(team));
+        w.str8(b.combatants[i]->getID().name);
+    }
+    w.end();
+
+    auto& battle = battles.emplace(id, std::move(b)).first->second;
+
+    // messages go straight into the frames, rather than into each TurnInfo
+    battle.encoder.reset(new Encoder{ battle.combatants });
+    battle.system->setMessageSink(*battle.encoder);
+
+    return advance(id, battle, out);
+}
+
+Progress BattleHost::act(std::uint32_t id, const ActRequest& req,
+                         std::vector<unsigned char>& out)
+{
+    using protocol::ActionType;
+
+    auto it = battles.find(id);
+    if (it == battles.end())
+        return fail(id, "no such battle", out);
+    auto& b = it->second;
+
+    const auto reject = [id, &out](const char* what) {
+        protocol::Writer w{ out };
+        w.begin(FrameType::Error);
+        w.u32(id);
+        w.str16(what);
+        w.end();
+        return Progress::Waiting;
+    };
+
+    auto* waiting = b.system->awaitingInput();
+    if (!waiting)
+        return reject("not waiting for input");
+
+    const auto options = waiting->options();
+    switch (req.action) {
+    case ActionType::Defend:
+        if (!options.defend)
+            return reject("can't defend");
+        return advance(id, b, out, battle::action::Defend{});
+
+    case ActionType::Flee:
+        if (!options.flee)
+            return reject("can't flee");
+        return advance(id, b, out, battle::action::Flee{});
+
+    case ActionType::Skill: {
+        if (req.skill >= options.skills.size())
+            return reject("no such skill");
+        if (req.target >= b.combatants.size())
+            return reject("no such target");
+
+        const auto skill = options.skills[req.skill];
+        const battle::Entity* target = b.combatants[req.target].get();
+        switch (skill->getDetails().getSpread()) {
+        case battle::SkillSpread::Self:
+        case battle::SkillSpread::Field:
+            target = &waiting->getEntity();
+            break;
+        default:
+            if (target->isDead())
+                return reject("target is dead");
+            break;
+        }
+        return advance(id, b, out, battle::action::Skill{ skill, *target });
+    }
+
+    default:
+        return reject("unknown action");
+    }
+}
+
+Progress BattleHost::resume(std::uint32_t id, std::vector<unsigned char>& out) {
+    auto it = battles.find(id);
+    if (it == battles.end())
+        return Progress::Ended;  // closed in the meantime
+    return advance(id, it->second, out);
+}
+
+void BattleHost::close(std::uint32_t id, std::vector<unsigned char>& out) {
+    battles.erase(id);
+
+    protocol::Writer w{ out };
+    w.begin(FrameType::Closed);
+    w.u32(id);
+    w.end();
+}
+
+Progress BattleHost::advance(std::uint32_t id, Battle& b, std::vector<unsigned char>& out,
+                             std::optional<battle::Action> choice)
+{
+    using protocol::BattleState;
+
+    const auto frame_start = out.size();
+    protocol::Writer w{ out };
+    w.begin(FrameType::Turn);
+    w.u32(id);
+    const auto count_at = w.reserve16();
+
+    auto& encoder = *b.encoder;
+    encoder.out = &out;
+    encoder.count = 0;
+
+    auto state = BattleState::Running;
+    try {
+        for (int turns = 0; ; turns++) {
+            if (b.system->isDone()) {
+                state = BattleState::Done;
+                break;
+            }
+            if (turns == turn_budget || encoder.count >= message_budget)
+                break;
+
+            // a player's choice goes straight into their parked turn
+            auto info = choice ? b.system->resume(*choice) : b.system->doTurn();
+            choice = std::nullopt;
+
+            if (info.need_user_input) {
+                state = BattleState::NeedInput;
+                break;
+            }
+        }
+    } catch (const std::exception& e) {
+        out.resize(frame_start);
+        auto result = fail(id, e.what(), out);
+        battles.erase(id);
+        return result;
+    }
+    encoder.out = nullptr;
+
+    w.patch16(count_at, static_cast<std::uint16_t>(encoder.count));
+    w.u8(static_cast<std::uint8_t>(state));
+    if (state == BattleState::NeedInput) {
+        const auto* waiting = b.system->awaitingInput();
+        const auto options = waiting->options();
+        w.u8(indexOf(b.combatants, waiting->getEntity()));
+        w.u8(static_cast<std::uint8_t>(std::min<std::size_t>(options.skills.size(), 0xff)));
+        for (std::size_t i = 0; i < options.skills.size() && i < 0xff; i++)
+            w.str8(options.skills[i]->getDetails().getName());
+    } else {
+        w.u8(0);
+        w.u8(0);
+    }
+    w.end();
+
+    switch (state) {
+    case BattleState::Running:
+        return Progress::Running;
+    case BattleState::NeedInput:
+        return Progress::Waiting;
+    case BattleState::Done:
+        break;
+    }
+    battles.erase(id);
+    return Progress::Ended;
+}
+
+Progress BattleHost::fail(std::uint32_t id, const char* what, std::vector<unsigned char>& out) {
+    protocol::Writer w{ out };
+    w.begin(FrameType::Error);
+    w.u32(id);
+    w.str16(what);
+    w.end();
+    return Progress::Ended;
+}
+
+
+}
@@ -0,0 +1,111 @@
+#ifndef SERVER_BATTLEHOST_H_INCLUDED
+#define SERVER_BATTLEHOST_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "battle/battlesystem.h"
+#include "battle/entityloader.h"
+#include "server/protocol.h"
+
+namespace battle {
+    class Entity;
+}
+
+namespace server {
+
+
+/// A decoded Create frame
+struct CreateRequest {
+    using Member = std::pair<std::string, std::string>; ///< kind and type
+
+    std::uint32_t tag;
+    std::vector<Member> players;
+    std::vector<Member> enemies;
+};
+
+/// A decoded Act frame
+struct ActRequest {
+    protocol::ActionType action;
+    std::uint8_t skill;
+    std::uint8_t target;
+};
+
+/// What a battle needs next, after a call into BattleHost
+enum class Progress {
+    Waiting, ///< nothing until the client acts
+    Running, ///< more turns to run; call `resume' again
+    Ended,   ///< the battle is finished (or failed) and has been removed
+};
+
+/// Owns and runs the battles pinned to one worker thread
+///
+/// All calls must come from that one thread: the battles' skills live in its
+/// lua state. Each call appends the frames to send back to the client to
+/// `out', and never throws; errors are reported to the client instead.
+class BattleHost {
+public:
+    BattleHost() = default;
+
+    BattleHost(const BattleHost&) = delete;
+    BattleHost& operator=(const BattleHost&) = delete;
+
+    /// Start battle `id' and run it until someone has to make a choice
+    Progress create(std::uint32_t id, const CreateRequest& req,
+                    std::vector<unsigned char>& out);
+
+    /// Submit the choice for the player battle `id' is waiting on
+    Progress act(std::uint32_t id, const ActRequest& req,
+                 std::vector<unsigned char>& out);
+
+    /// Continue a battle that stopped to let other battles have a go
+    Progress resume(std::uint32_t id, std::vector<unsigned char>& out);
+
+    /// Throw away battle `id'
+    void close(std::uint32_t id, std::vector<unsigned char>& out);
+
+    /// Throw away every battle
+    void clear() noexcept { battles.clear(); }
+
+    /// How many battles are currently hosted
+    [[nodiscard]] std::size_t size() const noexcept { return battles.size(); }
+
+private:
+    using EntityRef = std::shared_ptr<battle::Entity>;
+
+    /// The battle's message sink (see battlehost.cpp)
+    struct Encoder;
+    struct EncoderDeleter { void operator()(Encoder*) const noexcept; };
+
+    struct Battle {
+        std::vector<EntityRef> combatants; ///< players, then enemies
+        std::unique_ptr<Encoder, EncoderDeleter> encoder;
+        std::unique_ptr<battle::BattleSystem> system;
+    };
+
+    const battle::EntityTemplate& entityTemplate(const CreateRequest::Member& m);
+    EntityRef makeEntity(const CreateRequest::Member& m, int count);
+
+    /// Run turns until input is needed, the battle ends, or we've used up
+    /// this battle's share of the worker. `choice' finishes the parked turn.
+    Progress advance(std::uint32_t id, Battle& b, std::vector<unsigned char>& out,
+                     std::optional<battle::Action> choice = std::nullopt);
+
+    /// Report that `what' went wrong with `id' (a battle, or a Create's tag)
+    Progress fail(std::uint32_t id, const char* what, std::vector<unsigned char>& out);
+
+    std::unordered_map<std::uint32_t, Battle> battles;
+
+    /// Entity files, so they're only read once per worker
+    std::unordered_map<std::string, battle::EntityTemplate> templates;
+};
+
+
+}
+
+#endif // SERVER_BATTLEHOST_H_INCLUDED
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server/protocol.h"
+
+// Load generator for battle-server: each connection keeps a number of battles
+// going at once, playing random moves for its players, and timing how long
+// the server takes to answer each move.
+//
+// With no think time every move goes straight back, so the latencies mostly
+// measure how long a request queues behind everyone else's; add some think
+// time (as real players would have) to see the latency at a given load.
+
+namespace {
+
+using namespace server::protocol;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string path = "battle.sock";
+    unsigned connections = 4;
+    unsigned battles = 256;        // per connection
+    unsigned team_size = 4;        // per side
+    std::chrono::seconds duration{ 10 };
+    std::chrono::milliseconds think{ 0 };  // average wait before each move
+    std::string player_kind = "default", player_type = "good";
+    std::string enemy_kind = "default", enemy_type = "evil";
+    unsigned seed = std::random_device{}();
+};
+
+struct Results {
+    std::vector<std::uint64_t> latencies;  // nanoseconds, one per move
+    std::uint64_t completed = 0;           // battles that finished
+    std::uint64_t messages = 0;
+    std::uint64_t errors = 0;
+};
+
+class Client {
+public:
+    Client(const Options& opts, unsigned seed)
+        : opts{ opts }, rng{ seed }
+    {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            throw std::runtime_error(std::string{ "socket: " } + std::strerror(errno));
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (opts.path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("socket path too long");
+        std::copy(opts.path.begin(), opts.path.end(), addr.sun_path);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            ::close(fd);
+            throw std::runtime_error("connect " + opts.path + ": " + std::strerror(errno));
+        }
+
+    }
+
+    ~Client() { ::close(fd); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    Results run() {
+        deadline = Clock::now() + opts.duration;
+        for (unsigned i = 0; i < opts.battles; i++)
+            create();
+        send();
+
+        std::vector<unsigned char> in;
+        while (Clock::now() < deadline && (!battles.empty() || !creating.empty())) {
+            // sleep until the server says something or the next move is due;
+            // don't hang forever if the server stops answering, though
+            auto wait = std::chrono::milliseconds{ 2000 };
+            if (!moves.empty()) {
+                wait = std::chrono::ceil<std::chrono::milliseconds>(
+                    moves.top().due - Clock::now());
+                wait = std::max(wait, std::chrono::milliseconds{ 0 });
+            }
+            pollfd p{ fd, POLLIN, 0 };
+            const int ready = poll(&p, 1, static_cast<int>(wait.count()));
+            if (ready < 0 && errno != EINTR)
+                break;
+            if (ready == 0 && moves.empty())
+                break;  // timed out
+
+            while (!moves.empty() && moves.top().due <= Clock::now()) {
+                const auto m = moves.top();
+                moves.pop();
+                if (auto it = battles.find(m.id); it != battles.end())
+                    act(m.id, it->second, m.action, m.skill, m.target);
+            }
+            if (!(p.revents & POLLIN)) {
+                send();
+                continue;
+            }
+
+            const auto old_size = in.size();
+            in.resize(old_size + 64 * 1024);
+            const auto got = ::read(fd, in.data() + old_size, 64 * 1024);
+            if (got <= 0) {
+                if (got < 0 && errno == EINTR) {
+                    in.resize(old_size);
+                    continue;
+                }
+                break;  // closed, or timed out
+            }
+            in.resize(old_size + static_cast<std::size_t>(got));
+
+            std::size_t used = 0;
+            FrameView frame;
+            while (peekFrame(in.data() + used, in.size() - used, frame, SIZE_MAX)) {
+                handle(frame);
+                used += frame.total;
+            }
+            in.erase(in.begin(), in.begin() + static_cast<long>(used));
+            send();
+        }
+
+        return std::move(results);
+    }
+
+private:
+    enum class Team : std::uint8_t { Blue, Red };
+
+    /// A move we've decided on, but are still "thinking" about
+    struct Move {
+        Clock::time_point due;
+        std::uint32_t id;
+        ActionType action;
+        std::uint8_t skill;
+        std::uint8_t target;
+
+        friend bool operator>(const Move& lhs, const Move& rhs) noexcept {
+            return lhs.due > rhs.due;
+        }
+    };
+
+    struct Battle {
+        std::vector<Team> teams;
+        std::vector<bool> alive;
+        Clock::time_point sent;
+        bool pending = false;  // waiting on a reply to a move
+    };
+
+    void create() {
+        Writer w{ out };
+        w.begin(FrameType::Create);
+        w.u32(next_tag);
+        w.u8(static_cast<std::uint8_t>(opts.team_size));
+        for (unsigned i = 0; i < opts.team_size; i++) {
+            w.str8(opts.player_kind);
+            w.str8(opts.player_type);
+        }
+        w.u8(static_cast<std::uint8_t>(opts.team_size));
+        for (unsigned i = 0; i < opts.team_size; i++) {
+            w.str8(opts.enemy_kind);
+            w.str8(opts.enemy_type);
+        }
+        w.end();
+        creating.insert(next_tag++);
+    }
+
+    void act(std::uint32_t id, Battle& b, ActionType action,
+             std::uint8_t skill = 0, std::uint8_t target = 0)
+    {
+        Writer w{ out };
+        w.begin(FrameType::Act);
+        w.u32(id);
+        w.u8(static_cast<std::uint8_t>(action));
+        w.u8(skill);
+        w.u8(target);
+        w.end();
+        b.sent = Clock::now();
+        b.pending = true;
+    }
+
+    void send() {
+        std::size_t sent = 0;
+        while (sent < out.size()) {
+            const auto n = ::send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error(std::string{ "send: " } + std::strerror(errno));
+            }
+            sent += static_cast<std::size_t>(n);
+        }
+        out.clear();
+    }
+
+    void record(Clock::time_point sent) {
+        results.latencies.push_back(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent).count()));
+    }
+
+    void handle(const FrameView& frame) {
+        Reader r{ frame.payload, frame.size };
+        switch (frame.type) {
+        case FrameType::Created: {
+            const auto tag = r.u32();
+            const auto id = r.u32();
+            Battle b;
+            const auto count = r.u8();
+            for (unsigned i = 0; i < count; i++) {
+                b.teams.push_back(static_cast<Team>(r.u8()));
+                r.str8();
+            }
+            b.alive.assign(count, true);
+            creating.erase(tag);
+            battles.emplace(id, std::move(b));
+            break;
+        }
+
+        case FrameType::Turn: {
+            const auto id = r.u32();
+            auto& b = battles.at(id);
+            if (b.pending) {
+                record(b.sent);
+                b.pending = false;
+            }
+
+            const auto count = r.u16();
+            results.messages += count;
+            for (unsigned i = 0; i < count; i++) {
+                const auto m = r.message();
+                if (m.tag == MessageTag::Died)
+                    b.alive.at(m.entity) = false;
+            }
+
+            const auto state = static_cast<BattleState>(r.u8());
+            r.u8();  // actor: we play all our players the same way
+            const auto skills = r.u8();
+            for (unsigned i = 0; i < skills; i++)
+                r.str8();
+
+            if (state == BattleState::Done) {
+                battles.erase(id);
+                results.completed++;
+                if (Clock::now() < deadline)
+                    create();
+            } else if (state == BattleState::NeedInput) {
+                choose(id, b, skills);
+            }
+            break;
+        }
+
+        case FrameType::Error: {
+            const auto id = r.u32();
+            std::cerr << "server error: " << r.str16() << "\n";
+            results.errors++;
+            // a bad move; defending is always allowed
+            if (auto it = battles.find(id); it != battles.end())
+                act(id, it->second, ActionType::Defend);
+            else
+                creating.erase(id);
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    // attack a random living enemy with a random skill
+    void choose(std::uint32_t id, Battle& b, unsigned skills) {
+        std::vector<std::uint8_t> targets;
+        for (std::size_t i = 0; i < b.teams.size(); i++)
+            if (b.teams[i] == Team::Red && b.alive[i])
+                targets.push_back(static_cast<std::uint8_t>(i));
+
+        Move m{ Clock::now(), id, ActionType::Defend, 0, 0 };
+        if (skills != 0 && !targets.empty()) {
+            std::uniform_int_distribution<unsigned> skill_dist{ 0, skills - 1 };
+            std::uniform_int_distribution<std::size_t> target_dist{ 0, targets.size() - 1 };
+            m.action = ActionType::Skill;
+            m.skill = static_cast<std::uint8_t>(skill_dist(rng));
+            m.target = targets[target_dist(rng)];
+        }
+
+        if (opts.think.count() == 0) {
+            act(id, b, m.action, m.skill, m.target);
+        } else {
+            std::uniform_int_distribution<long> think_dist{ 0, 2 * opts.think.count() };
+            m.due += std::chrono::milliseconds{ think_dist(rng) };
+            moves.push(m);
+        }
+    }
+
+    const Options& opts;
+    std::mt19937 rng;
+    int fd;
+    Clock::time_point deadline;
+
+    std::uint32_t next_tag = 0;
+    std::unordered_set<std::uint32_t> creating;  // tags of unanswered Creates
+    std::unordered_map<std::uint32_t, Battle> battles;
+    std::priority_queue<Move, std::vector<Move>, std::greater<>> moves;
+    std::vector<unsigned char> out;
+    Results results;
+};
+
+int usage(const char* name) {
+    std::cerr << "usage: " << name << " [--socket PATH] [--connections N] [--battles N]\n"
+              << "       [--team-size N] [--duration SECONDS] [--player KIND TYPE]\n"
+              << "       [--enemy KIND TYPE] [--think MS] [--seed N]\n"
+              << "Plays random battles against battle-server, and writes a JSON\n"
+              << "summary of the server's response times to stdout.\n";
+    return 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            const auto has = [&](int n) { return i + n < argc; };
+            if (arg == "--socket" && has(1))
+                opts.path = argv[++i];
+            else if (arg == "--connections" && has(1))
+                opts.connections = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (arg == "--battles" && has(1))
+                opts.battles = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (arg == "--team-size" && has(1))
+                opts.team_size = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (arg == "--duration" && has(1))
+                opts.duration = std::chrono::seconds{ std::stol(argv[++i]) };
+            else if (arg == "--player" && has(2)) {
+                opts.player_kind = argv[++i];
+                opts.player_type = argv[++i];
+            } else if (arg == "--enemy" && has(2)) {
+                opts.enemy_kind = argv[++i];
+                opts.enemy_type = argv[++i];
+            } else if (arg == "--think" && has(1))
+                opts.think = std::chrono::milliseconds{ std::stol(argv[++i]) };
+            else if (arg == "--seed" && has(1))
+                opts.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+            else
+                return usage(argv[0]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return usage(argv[0]);
+    }
+    if (opts.connections == 0 || opts.team_size == 0 || 2 * opts.team_size > max_combatants)
+        return usage(argv[0]);
+
+    std::vector<Results> results(opts.connections);
+    std::vector<std::thread> threads;
+    const auto start = Clock::now();
+    for (unsigned i = 0; i < opts.connections; i++) {
+        threads.emplace_back([&opts, &results, i] {
+            try {
+                Client client{ opts, opts.seed + i };
+                results[i] = client.run();
+            } catch (const std::exception& e) {
+                std::cerr << "connection " << i << ": " << e.what() << "\n";
+            }
+        });
+    }
+    for (auto&& t : threads)
+        t.join();
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Results total;
+    for (auto&& r : results) {
+        total.latencies.insert(total.latencies.end(), r.latencies.begin(), r.latencies.end());
+        total.completed += r.completed;
+        total.messages += r.messages;
+        total.errors += r.errors;
+    }
+    std::sort(total.latencies.begin(), total.latencies.end());
+
+    const auto percentile = [&total](double p) -> double {
+        if (total.latencies.empty())
+            return 0;
+        const auto index = static_cast<std::size_t>(p * static_cast<double>(total.latencies.size() - 1));
+        return static_cast<double>(total.latencies[index]) / 1000.0;
+    };
+
+    std::cout << "{\"connections\":" << opts.connections
+              << ",\"concurrent_battles\":" << opts.connections * opts.battles
+              << ",\"team_size\":" << opts.team_size
+              << ",\"think_ms\":" << opts.think.count()
+              << ",\"seconds\":" << elapsed
+              << ",\"moves\":" << total.latencies.size()
+              << ",\"moves_per_sec\":" << static_cast<double>(total.latencies.size()) / elapsed
+              << ",\"battles_completed\":" << total.completed
+              << ",\"messages\":" << total.messages
+              << ",\"errors\":" << total.errors
+              << ",\"latency_us\":{\"p50\":" << percentile(0.5)
+              << ",\"p90\":" << percentile(0.9)
+              << ",\"p99\":" << percentile(0.99)
+              << ",\"max\":" << percentile(1.0)
+              << "}}" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "server/protocol.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace server::protocol {
+
+
+void Writer::begin(FrameType type) {
+    frame_start = out.size();
+    out.insert(out.end(), header_size, 0);
+    out[frame_start + 4] = static_cast<unsigned char>(type);
+}
+
+void Writer::end() {
+    const auto size = static_cast<std::uint32_t>(out.size() - frame_start - header_size);
+    for (std::size_t i = 0; i < 4; i++)
+        out[frame_start + i] = static_cast<unsigned char>(size >> (8 * i));
+}
+
+void Writer::u8(std::uint8_t value) {
+    out.push_back(value);
+}
+
+void Writer::u16(std::uint16_t value) {
+    out.push_back(static_cast<unsigned char>(value));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+void Writer::u32(std::uint32_t value) {
+    for (std::size_t i = 0; i < 4; i++)
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+void Writer::i32(std::int32_t value) {
+    u32(static_cast<std::uint32_t>(value));
+}
+
+void Writer::str8(std::string_view value) {
+    const auto size = std::min<std::size_t>(value.size(), 0xff);
+    u8(static_cast<std::uint8_t>(size));
+    out.insert(out.end(), value.begin(), value.begin() + static_cast<long>(size));
+}
+
+void Writer::str16(std::string_view value) {
+    const auto size = std::min<std::size_t>(value.size(), 0xffff);
+    u16(static_cast<std::uint16_t>(size));
+    out.insert(out.end(), value.begin(), value.begin() + static_cast<long>(size));
+}
+
+std::size_t Writer::reserve16() {
+    const auto at = out.size();
+    u16(0);
+    return at;
+}
+
+void Writer::patch16(std::size_t at, std::uint16_t value) noexcept {
+    out[at] = static_cast<unsigned char>(value);
+    out[at + 1] = static_cast<unsigned char>(value >> 8);
+}
+
+
+const unsigned char* Reader::need(std::size_t count) {
+    if (static_cast<std::size_t>(last - pos) < count)
+        throw std::invalid_argument("protocol: truncated frame");
+    auto p = pos;
+    pos += count;
+    return p;
+}
+
+std::uint8_t Reader::u8() {
+    return *need(1);
+}
+
+std::uint16_t Reader::u16() {
+    auto p = need(2);
+    return static_cast<std::uint16_t>(p[0] | p[1] << 8);
+}
+
+std::uint32_t Reader::u32() {
+    auto p = need(4);
+    std::uint32_t value = 0;
+    for (std::size_t i = 0; i < 4; i++)
+        value |= std::uint32_t{ p[i] } << (8 * i);
+    return value;
+}
+
+std::int32_t Reader::i32() {
+    return static_cast<std::int32_t>(u32());
+}
+
+std::string Reader::str8() {
+    const auto size = u8();
+    auto p = need(size);
+    return std::string(p, p + size);
+}
+
+std::string Reader::str16() {
+    const auto size = u16();
+    auto p = need(size);
+    return std::string(p, p + size);
+}
+
+WireMessage Reader::message() {
+    WireMessage m;
+    m.tag = static_cast<MessageTag>(u8());
+    switch (m.tag) {
+    case MessageTag::SkillUsed:
+        m.entity = u8();
+        m.other = u8();
+        m.text = str8();
+        break;
+    case MessageTag::Miss:
+    case MessageTag::Critical:
+    case MessageTag::Defended:
+    case MessageTag::Died:
+        m.entity = u8();
+        break;
+    case MessageTag::PoolChanged:
+        m.entity = u8();
+        m.other = u8();
+        m.old_value = i32();
+        m.new_value = i32();
+        break;
+    case MessageTag::StatusEffect:
+        m.entity = u8();
+        m.other = u8();
+        m.text = str8();
+        break;
+    case MessageTag::Fled:
+        m.entity = u8();
+        m.other = u8();
+        break;
+    case MessageTag::Notification:
+        m.text = str16();
+        break;
+    default:
+        throw std::invalid_argument("protocol: unknown message tag");
+    }
+    return m;
+}
+
+
+bool peekFrame(const unsigned char* data, std::size_t size,
+               FrameView& frame, std::size_t limit)
+{
+    if (size < header_size)
+        return false;
+
+    std::size_t length = 0;
+    for (std::size_t i = 0; i < 4; i++)
+        length |= std::size_t{ data[i] } << (8 * i);
+    if (length > limit)
+        throw std::invalid_argument("protocol: frame too large");
+    if (size - header_size < length)
+        return false;
+
+    frame.type = static_cast<FrameType>(data[4]);
+    frame.payload = data + header_size;
+    frame.size = length;
+    frame.total = header_size + length;
+    return true;
+}
+
+
+}
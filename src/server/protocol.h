@@ -0,0 +1,185 @@
+#ifndef SERVER_PROTOCOL_H_INCLUDED
+#define SERVER_PROTOCOL_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// The wire format spoken between the battle server and its clients.
+///
+/// Every frame is a little-endian `u32' payload length, followed by a `u8'
+/// frame type and then the payload itself. Strings are a length (`u8' or
+/// `u16', as noted) followed by that many bytes. Combatants are referred to
+/// by their index in the battle: the players in the order they were given,
+/// then the enemies.
+///
+/// Client to server:
+///   Create  u32 tag, u8 #players, {str8 kind, str8 type}...,
+///                    u8 #enemies, {str8 kind, str8 type}...
+///   Act     u32 battle, u8 action, u8 skill, u8 target
+///   Close   u32 battle
+///
+/// Server to client:
+///   Created u32 tag, u32 battle, u8 #combatants, {u8 team, str8 name}...
+///   Turn    u32 battle, u16 #messages, {message}...,
+///           u8 state, u8 actor, u8 #skills, {str8 name}...
+///   Error   u32 battle (or tag), str16 what
+///   Closed  u32 battle
+///
+/// A Turn frame covers everything that happened since the last one, up to
+/// the point where a player has to make a choice or the battle ends. When
+/// input is needed, `actor' is the player to move and the skills are the
+/// ones they can currently use (`skill' in Act indexes this list).
+namespace server::protocol {
+
+
+/// Clients may not send frames bigger than this
+inline constexpr std::size_t max_frame_size = 64 * 1024;
+
+/// Size of the length prefix and type byte at the start of every frame
+inline constexpr std::size_t header_size = 5;
+
+/// No battle can have more combatants than this, so they fit in a `u8'
+inline constexpr std::size_t max_combatants = 255;
+
+enum class FrameType : std::uint8_t {
+    // client to server
+    Create  = 0x01,
+    Act     = 0x02,
+    Close   = 0x03,
+
+    // server to client
+    Created = 0x81,
+    Turn    = 0x82,
+    Error   = 0x83,
+    Closed  = 0x84,
+};
+
+/// What a player chose to do (see Act)
+enum class ActionType : std::uint8_t {
+    Defend = 0,
+    Flee   = 1,
+    Skill  = 2,
+};
+
+/// Where a battle is at after a Turn
+enum class BattleState : std::uint8_t {
+    Running   = 0, ///< still going, more Turns will follow without an Act
+    NeedInput = 1, ///< waiting on an Act for `actor'
+    Done      = 2, ///< one side has won; the battle is gone
+};
+
+/// One entry per battle::Message alternative, in the same order
+///
+/// Layouts (`e' is a combatant index):
+///   SkillUsed    u8 source, u8 target, str8 skill
+///   Miss         u8 e
+///   Critical     u8 e
+///   PoolChanged  u8 e, u8 pool, i32 old, i32 new
+///   StatusEffect u8 e, u8 applied, str8 effect
+///   Defended     u8 e
+///   Fled         u8 e, u8 succeeded
+///   Died         u8 e
+///   Notification str16 message
+enum class MessageTag : std::uint8_t {
+    SkillUsed,
+    Miss,
+    Critical,
+    PoolChanged,
+    StatusEffect,
+    Defended,
+    Fled,
+    Died,
+    Notification,
+};
+
+/// A decoded message; which fields are meaningful depends on `tag'
+struct WireMessage {
+    MessageTag tag = MessageTag::Notification;
+    std::uint8_t entity = 0;  ///< the entity (or source, for SkillUsed)
+    std::uint8_t other = 0;   ///< target, pool, applied, or succeeded
+    std::int32_t old_value = 0;
+    std::int32_t new_value = 0;
+    std::string text;         ///< skill, effect, or notification
+};
+
+
+/// Appends frames to a byte buffer
+class Writer {
+public:
+    explicit Writer(std::vector<unsigned char>& out) noexcept
+        : out{ out }
+    {}
+
+    /// Start a new frame; the length is filled in by `end'
+    void begin(FrameType type);
+    /// Finish the current frame
+    void end();
+
+    void u8(std::uint8_t value);
+    void u16(std::uint16_t value);
+    void u32(std::uint32_t value);
+    void i32(std::int32_t value);
+
+    /// Strings longer than the prefix allows are truncated
+    void str8(std::string_view value);
+    void str16(std::string_view value);
+
+    /// Leave room for a `u16' that isn't known yet; returns where it goes
+    std::size_t reserve16();
+    /// Fill in a `u16' left by `reserve16'
+    void patch16(std::size_t at, std::uint16_t value) noexcept;
+
+private:
+    std::vector<unsigned char>& out;
+    std::size_t frame_start = 0;
+};
+
+/// Reads the fields of a single frame's payload
+/// Throws std::invalid_argument if the payload runs out early.
+class Reader {
+public:
+    Reader(const unsigned char* data, std::size_t size) noexcept
+        : pos{ data }, last{ data + size }
+    {}
+
+    std::uint8_t u8();
+    std::uint16_t u16();
+    std::uint32_t u32();
+    std::int32_t i32();
+
+    std::string str8();
+    std::string str16();
+
+    WireMessage message();
+
+    /// Have we consumed the whole payload?
+    [[nodiscard]] bool done() const noexcept { return pos == last; }
+
+private:
+    const unsigned char* need(std::size_t count);
+
+    const unsigned char* pos;
+    const unsigned char* last;
+};
+
+/// A complete frame sitting in a receive buffer
+struct FrameView {
+    FrameType type;
+    const unsigned char* payload;
+    std::size_t size;   ///< of the payload
+    std::size_t total;  ///< bytes taken up by the whole frame, header and all
+};
+
+/// Look for a complete frame at the start of `data'
+/// Returns false if more bytes are needed; throws std::invalid_argument if
+/// the frame claims to be bigger than `limit'.
+bool peekFrame(const unsigned char* data, std::size_t size,
+               FrameView& frame, std::size_t limit = max_frame_size);
+
+
+}
+
+#endif // SERVER_PROTOCOL_H_INCLUDED
@@ -0,0 +1,463 @@
+#include "server/server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace server {
+
+using protocol::FrameType;
+
+namespace {
+    // epoll keys for the fds that aren't client connections
+    constexpr std::uint64_t listen_key = 0;
+    constexpr std::uint64_t event_key = 1;
+    constexpr std::uint64_t signal_key = 2;
+    constexpr std::uint64_t first_conn = 3;
+
+    constexpr std::size_t read_chunk = 64 * 1024;
+
+    // the most one read pass takes from a connection before moving on to
+    // the next, so one busy client can't starve the rest; whatever's left
+    // is still there next time round
+    constexpr std::size_t read_budget = 4 * read_chunk;
+
+    // replies queued for a client that isn't reading them; past the high
+    // mark we stop reading its requests, until it's down to the low mark
+    constexpr std::size_t out_high_water = 1024 * 1024;
+    constexpr std::size_t out_low_water = out_high_water / 4;
+
+    [[noreturn]] void throwErrno(const std::string& what) {
+        throw std::runtime_error(what + ": " + std::strerror(errno));
+    }
+
+    void watch(int epoll_fd, int fd, std::uint32_t events, std::uint64_t key) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = key;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            throwErrno("epoll_ctl");
+    }
+}
+
+
+Server::Server(std::string path_, std::size_t workers)
+    : path{ std::move(path_) }
+    , next_conn{ first_conn }
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("socket path too long: " + path);
+    std::copy(path.begin(), path.end(), addr.sun_path);
+
+    // signals are picked up by the event loop; block them before starting
+    // any threads so they all inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0)
+        throwErrno("signalfd");
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+        throwErrno("socket");
+    ::unlink(path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        throwErrno("bind " + path);
+    if (listen(listen_fd, SOMAXCONN) < 0)
+        throwErrno("listen");
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0)
+        throwErrno("eventfd");
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        throwErrno("epoll_create1");
+    watch(epoll_fd, listen_fd, EPOLLIN, listen_key);
+    watch(epoll_fd, event_fd, EPOLLIN, event_key);
+    watch(epoll_fd, signal_fd, EPOLLIN, signal_key);
+
+    hosts.resize(std::max<std::size_t>(workers, 1));
+    for (auto&& h : hosts)
+        h = std::make_unique<BattleHost>();
+    pool = std::make_unique<WorkerPool>(hosts.size());
+}
+
+Server::~Server() {
+    stopping = true;
+
+    // the battles have to go on the threads that made them, while their lua
+    // states are still around; anything still queued after this finds its
+    // battle gone, and nothing new gets created once the loop has stopped
+    if (pool) {
+        for (std::size_t i = 0; i < hosts.size(); i++)
+            pool->post(i, [this, i]{ hosts[i]->clear(); });
+        pool.reset();
+    }
+
+    for (auto&& [id, c] : connections)
+        ::close(c.fd);
+    for (int fd : { epoll_fd, event_fd, signal_fd, listen_fd })
+        if (fd >= 0)
+            ::close(fd);
+    if (listen_fd >= 0)
+        ::unlink(path.c_str());
+}
+
+std::size_t Server::workerFor(std::uint32_t battle) const noexcept {
+    return battle % hosts.size();
+}
+
+
+// The event loop
+
+void Server::run() {
+    std::vector<epoll_event> events(256);
+    while (true) {
+        const int count = epoll_wait(epoll_fd, events.data(),
+                                     static_cast<int>(events.size()), -1);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            throwErrno("epoll_wait");
+        }
+
+        for (int i = 0; i < count; i++) {
+            const auto& ev = events[static_cast<std::size_t>(i)];
+            switch (ev.data.u64) {
+            case listen_key:
+                accept();
+                break;
+
+            case event_key:
+                drainCompletions();
+                break;
+
+            case signal_key:
+                return;
+
+            default: {
+                // an earlier event this round may have dropped the connection
+                auto it = connections.find(ev.data.u64);
+                if (it == connections.end())
+                    break;
+                if (ev.events & (EPOLLERR | EPOLLHUP)) {
+                    drop(it->first);
+                    break;
+                }
+                if (ev.events & EPOLLOUT)
+                    flush(it->first, it->second);
+                if (ev.events & EPOLLIN) {
+                    // flush could have dropped it
+                    it = connections.find(ev.data.u64);
+                    if (it != connections.end())
+                        read(it->first, it->second);
+                }
+                break;
+            }
+            }
+        }
+    }
+}
+
+void Server::accept() {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            return;  // EAGAIN, or the client went away already; either way, done
+        }
+
+        const auto id = next_conn++;
+        watch(epoll_fd, fd, EPOLLIN | EPOLLRDHUP, id);
+        connections.emplace(id, Connection{ fd, {}, {}, 0, false, true, {} });
+    }
+}
+
+void Server::read(ConnId id, Connection& c) {
+    // an event from before we stopped listening to it
+    if (!c.reading)
+        return;
+
+    for (std::size_t total = 0; total < read_budget; ) {
+        const auto old_size = c.in.size();
+        c.in.resize(old_size + read_chunk);
+        const auto got = ::read(c.fd, c.in.data() + old_size, read_chunk);
+        if (got <= 0) {
+            c.in.resize(old_size);
+            if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+                drop(id);
+                return;
+            }
+            if (errno == EAGAIN)
+                break;
+            continue;
+        }
+        c.in.resize(old_size + static_cast<std::size_t>(got));
+        total += static_cast<std::size_t>(got);
+    }
+
+    std::size_t used = 0;
+    try {
+        protocol::FrameView frame;
+        while (protocol::peekFrame(c.in.data() + used, c.in.size() - used, frame)) {
+            if (!handleFrame(id, c, frame)) {
+                drop(id);
+                return;
+            }
+            used += frame.total;
+        }
+    } catch (const std::invalid_argument&) {
+        // no point trying to resynchronise; the client is broken
+        drop(id);
+        return;
+    }
+    c.in.erase(c.in.begin(), c.in.begin() + static_cast<long>(used));
+
+    // anything we had to say ourselves (errors, mostly)
+    flush(id, c);
+}
+
+void Server::flush(ConnId id, Connection& c) {
+    while (c.out_sent < c.out.size()) {
+        const auto sent = ::send(c.fd, c.out.data() + c.out_sent,
+                                 c.out.size() - c.out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                break;
+            drop(id);
+            return;
+        }
+        c.out_sent += static_cast<std::size_t>(sent);
+    }
+
+    const auto queued = c.out.size() - c.out_sent;
+    if (queued == 0) {
+        c.out.clear();
+        c.out_sent = 0;
+    }
+
+    const bool pending = queued > 0;
+    bool reading = c.reading;
+    if (queued > out_high_water)
+        reading = false;
+    else if (queued <= out_low_water)
+        reading = true;
+
+    if (pending != c.want_write || reading != c.reading) {
+        // not EPOLLRDHUP either while we're not reading, or a client that
+        // hung up would wake us over and over
+        epoll_event ev{};
+        ev.events = (reading ? EPOLLIN | EPOLLRDHUP : 0u) | (pending ? EPOLLOUT : 0u);
+        ev.data.u64 = id;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+        c.want_write = pending;
+        c.reading = reading;
+    }
+}
+
+void Server::drop(ConnId id) {
+    auto it = connections.find(id);
+    if (it == connections.end())
+        return;
+
+    // nobody's listening, so there's no point running the battles any more
+    for (auto battle : it->second.battles) {
+        owners.erase(battle);
+        pool->post(workerFor(battle), [this, battle, w = workerFor(battle)]{
+            std::vector<unsigned char> discard;
+            hosts[w]->close(battle, discard);
+        });
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    ::close(it->second.fd);
+    connections.erase(it);
+}
+
+void Server::drainCompletions() {
+    std::uint64_t value;
+    while (::read(event_fd, &value, sizeof(value)) > 0) {}
+
+    std::vector<Completion> batch;
+    {
+        std::lock_guard lock{ completion_mutex };
+        std::swap(batch, completions);
+    }
+
+    // collect everything for a connection before writing any of it
+    std::vector<ConnId> touched;
+    for (auto&& done : batch) {
+        if (done.ended) {
+            owners.erase(done.ended);
+            if (auto it = connections.find(done.conn); it != connections.end()) {
+                auto& battles = it->second.battles;
+                battles.erase(std::remove(battles.begin(), battles.end(), done.ended),
+                              battles.end());
+            }
+        }
+
+        auto it = connections.find(done.conn);
+        if (it == connections.end())
+            continue;
+        auto& out = it->second.out;
+        out.insert(out.end(), done.bytes.begin(), done.bytes.end());
+        touched.push_back(done.conn);
+    }
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (auto id : touched)
+        if (auto it = connections.find(id); it != connections.end())
+            flush(id, it->second);
+}
+
+
+// Requests
+
+bool Server::handleFrame(ConnId id, Connection& c, const protocol::FrameView& frame) {
+    protocol::Reader r{ frame.payload, frame.size };
+
+    switch (frame.type) {
+    case FrameType::Create: {
+        CreateRequest req;
+        req.tag = r.u32();
+        for (auto* team : { &req.players, &req.enemies }) {
+            const auto count = r.u8();
+            for (unsigned i = 0; i < count; i++) {
+                auto kind = r.str8();
+                auto type = r.str8();
+                team->emplace_back(std::move(kind), std::move(type));
+            }
+        }
+        if (!r.done())
+            return false;
+        if (req.players.size() + req.enemies.size() > protocol::max_combatants) {
+            sendError(c, req.tag, "too many combatants");
+            return true;
+        }
+
+        // 0 means "no battle" in completions, so skip it
+        if (++next_battle == 0)
+            ++next_battle;
+        const auto battle = next_battle;
+        owners.emplace(battle, id);
+        c.battles.push_back(battle);
+
+        const auto w = workerFor(battle);
+        pool->post(w, [this, w, id, battle, req = std::move(req)]{
+            std::vector<unsigned char> out;
+            auto progress = hosts[w]->create(battle, req, out);
+            finish(w, id, battle, progress, std::move(out));
+        });
+        return true;
+    }
+
+    case FrameType::Act: {
+        const auto battle = r.u32();
+        ActRequest req;
+        req.action = static_cast<protocol::ActionType>(r.u8());
+        req.skill = r.u8();
+        req.target = r.u8();
+        if (!r.done())
+            return false;
+
+        auto owner = owners.find(battle);
+        if (owner == owners.end() || owner->second != id) {
+            sendError(c, battle, "no such battle");
+            return true;
+        }
+
+        const auto w = workerFor(battle);
+        pool->post(w, [this, w, id, battle, req]{
+            std::vector<unsigned char> out;
+            auto progress = hosts[w]->act(battle, req, out);
+            finish(w, id, battle, progress, std::move(out));
+        });
+        return true;
+    }
+
+    case FrameType::Close: {
+        const auto battle = r.u32();
+        if (!r.done())
+            return false;
+
+        auto owner = owners.find(battle);
+        if (owner == owners.end() || owner->second != id) {
+            sendError(c, battle, "no such battle");
+            return true;
+        }
+
+        const auto w = workerFor(battle);
+        pool->post(w, [this, w, id, battle]{
+            std::vector<unsigned char> out;
+            hosts[w]->close(battle, out);
+            finish(w, id, battle, Progress::Ended, std::move(out));
+        });
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+void Server::sendError(Connection& c, std::uint32_t id, const char* what) {
+    protocol::Writer w{ c.out };
+    w.begin(FrameType::Error);
+    w.u32(id);
+    w.str16(what);
+    w.end();
+}
+
+void Server::finish(std::size_t worker, ConnId conn, std::uint32_t battle,
+                    Progress progress, std::vector<unsigned char> bytes)
+{
+    // long computer-only stretches go to the back of the queue, so that one
+    // battle can't hog the worker
+    if (progress == Progress::Running && !stopping) {
+        pool->post(worker, [this, worker, conn, battle]{
+            std::vector<unsigned char> out;
+            auto progress = hosts[worker]->resume(battle, out);
+            finish(worker, conn, battle, progress, std::move(out));
+        });
+    }
+
+    complete({ conn, std::move(bytes), progress == Progress::Ended ? battle : 0 });
+}
+
+void Server::complete(Completion c) {
+    bool was_empty;
+    {
+        std::lock_guard lock{ completion_mutex };
+        was_empty = completions.empty();
+        completions.push_back(std::move(c));
+    }
+    // only the first completion needs to wake the event loop up
+    if (was_empty) {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] auto ignored = ::write(event_fd, &one, sizeof(one));
+    }
+}
+
+
+}
@@ -0,0 +1,104 @@
+#ifndef SERVER_SERVER_H_INCLUDED
+#define SERVER_SERVER_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "server/battlehost.h"
+#include "server/workerpool.h"
+
+namespace server {
+
+
+/// Hosts battles for clients connecting over a Unix-domain socket
+///
+/// One thread runs the event loop (epoll), handling all socket I/O and
+/// decoding requests; the battles themselves are spread over a pool of
+/// workers, each battle pinned to the worker that created it. Workers hand
+/// their replies back to the event loop through a queue and an eventfd.
+/// A client that lets its replies pile up has its requests left unread
+/// until it catches up.
+///
+/// See server/protocol.h for what goes over the wire.
+class Server {
+public:
+    /// Listen on `path' (replacing any stale socket), with `workers' threads
+    /// Throws std::runtime_error if the socket can't be set up.
+    Server(std::string path, std::size_t workers);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /// Serve clients until SIGINT or SIGTERM
+    void run();
+
+private:
+    using ConnId = std::uint64_t;
+
+    struct Connection {
+        int fd;
+        std::vector<unsigned char> in;
+        std::vector<unsigned char> out;
+        std::size_t out_sent = 0;  ///< how much of `out' has gone already
+        bool want_write = false;   ///< registered for EPOLLOUT?
+        bool reading = true;       ///< registered for EPOLLIN? (see flush)
+        std::vector<std::uint32_t> battles;
+    };
+
+    /// A worker's reply, on its way back to the event loop
+    struct Completion {
+        ConnId conn;
+        std::vector<unsigned char> bytes;
+        std::uint32_t ended;  ///< battle that's now gone, or 0 for none
+    };
+
+    void accept();
+    void read(ConnId id, Connection& c);
+    void flush(ConnId id, Connection& c);
+    void drop(ConnId id);
+    void drainCompletions();
+
+    /// Decode and dispatch a single frame; returns false on a protocol error
+    bool handleFrame(ConnId id, Connection& c, const protocol::FrameView& frame);
+    void sendError(Connection& c, std::uint32_t id, const char* what);
+
+    /// Runs on a worker: deal with what a BattleHost call says comes next
+    void finish(std::size_t worker, ConnId conn, std::uint32_t battle,
+                Progress progress, std::vector<unsigned char> bytes);
+    void complete(Completion c);
+
+    std::size_t workerFor(std::uint32_t battle) const noexcept;
+
+    std::string path;
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    int event_fd = -1;   ///< workers poke this when there are completions
+    int signal_fd = -1;
+
+    std::unordered_map<ConnId, Connection> connections;
+    ConnId next_conn = 0;
+
+    /// Which connection each live battle belongs to
+    std::unordered_map<std::uint32_t, ConnId> owners;
+    std::uint32_t next_battle = 0;
+
+    std::mutex completion_mutex;
+    std::vector<Completion> completions;
+
+    std::atomic<bool> stopping = false;
+
+    /// One per worker, and only ever touched from that worker
+    std::vector<std::unique_ptr<BattleHost>> hosts;
+    std::unique_ptr<WorkerPool> pool;
+};
+
+
+}
+
+#endif // SERVER_SERVER_H_INCLUDED
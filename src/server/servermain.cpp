@@ -0,0 +1,48 @@
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "server/server.h"
+
+int usage(const char* name) {
+    std::cerr << "usage: " << name << " [--socket PATH] [--workers N]\n"
+              << "Hosts battles over a Unix-domain socket until interrupted.\n";
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = "battle.sock";
+    std::size_t workers = std::thread::hardware_concurrency();
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (i + 1 >= argc)
+                return usage(argv[0]);
+            else if (arg == "--socket")
+                path = argv[++i];
+            else if (arg == "--workers")
+                workers = std::stoul(argv[++i]);
+            else
+                return usage(argv[0]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return usage(argv[0]);
+    }
+
+    try {
+        server::Server server{ path, workers };
+        std::cerr << "listening on " << path << "\n";
+        server.run();
+        std::cerr << "shutting down\n";
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "server/workerpool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace server {
+
+
+WorkerPool::WorkerPool(std::size_t count) {
+    count = std::max<std::size_t>(count, 1);
+    workers.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        workers.push_back(std::make_unique<Worker>());
+        auto& w = *workers.back();
+        w.thread = std::thread{ [&w]{ run(w); } };
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    for (auto&& w : workers) {
+        {
+            std::lock_guard lock{ w->mutex };
+            w->stopping = true;
+        }
+        w->wake.notify_one();
+    }
+    for (auto&& w : workers)
+        w->thread.join();
+}
+
+void WorkerPool::post(std::size_t worker, Task task) {
+    auto& w = *workers[worker % workers.size()];
+    bool was_empty;
+    {
+        std::lock_guard lock{ w.mutex };
+        was_empty = w.queue.empty();
+        w.queue.push_back(std::move(task));
+    }
+    // if the queue wasn't empty the worker is already awake (or about to be)
+    if (was_empty)
+        w.wake.notify_one();
+}
+
+void WorkerPool::run(Worker& w) {
+    // take the whole queue at once, so posting doesn't wait on running tasks
+    std::vector<Task> batch;
+    while (true) {
+        {
+            std::unique_lock lock{ w.mutex };
+            w.wake.wait(lock, [&w]{ return w.stopping || !w.queue.empty(); });
+            if (w.queue.empty())
+                return;  // only get here when stopping
+            std::swap(batch, w.queue);
+        }
+        for (auto&& task : batch)
+            task();
+        batch.clear();
+    }
+}
+
+
+}
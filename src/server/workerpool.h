@@ -0,0 +1,56 @@
+#ifndef SERVER_WORKERPOOL_H_INCLUDED
+#define SERVER_WORKERPOOL_H_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace server {
+
+
+/// A fixed set of threads, each with its own task queue
+///
+/// Unlike a shared-queue pool, tasks are posted to a particular worker. The
+/// engine keeps per-thread state (the lua state, the random generator), so a
+/// battle has to be created and run on the same thread for its whole life.
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    /// Start `count' workers (at least one)
+    explicit WorkerPool(std::size_t count);
+
+    /// Runs every task already posted, then joins the workers
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    [[nodiscard]] std::size_t size() const noexcept { return workers.size(); }
+
+    /// Queue `task' to run on worker number `worker' (modulo the pool size)
+    /// Tasks on the same worker run in the order they were posted.
+    void post(std::size_t worker, Task task);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<Task> queue;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    static void run(Worker& w);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+};
+
+
+}
+
+#endif // SERVER_WORKERPOOL_H_INCLUDED
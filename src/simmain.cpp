@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "battle/battlesystem.h"
+#include "battle/decisionlog.h"
+#include "battle/entity.h"
+#include "battle/entityloader.h"
+#include "battle/logsink.h"
+#include "battle/luamemory.h"
+#include "battle/messagesink.h"
+#include "battle/npcside.h"
+#include "battle/skillprofile.h"
+#include "battle/statistics.h"
+#include "util/logwriter.h"
+#include "util/random.h"
+#include "util/trace.h"
+#include "util/workpool.h"
+
+namespace {
+
+using EntityRef = std::shared_ptr<battle::Entity>;
+
+// battles are handed out to threads this many at a time
+constexpr long chunk_size = 64;
+
+// the lua collector gets more time between battles than between turns
+constexpr std::size_t battle_collect_kb = 1024;
+
+using Side = battle::NPCSide;
+
+/// Something to vary across the sweep, for one side
+struct Axis {
+    bool player;       ///< which side it applies to
+    std::string stat;  ///< the base stat to override, or empty for skill level
+    std::vector<int> values;
+
+    std::string name() const {
+        return (player ? "player." : "enemy.") + (stat.empty() ? "level" : stat);
+    }
+
+    void apply(Side& side, int value) const {
+        if (stat.empty())
+            side.level = value;
+        else
+            *battle::findBaseStat(side.entity.stats, stat) = value;
+    }
+};
+
+struct Options {
+    long battles = 1000;  ///< in total, or per cell when sweeping
+    std::size_t threads = std::thread::hardware_concurrency();
+    long team_size = 1;
+    long max_turns = 10000;
+    Side player = { "default", "good" };
+    Side enemy = { "default", "evil" };
+    std::vector<Axis> axes = {};
+    std::optional<unsigned> seed = std::nullopt;
+    std::size_t profile_top = 0;  ///< how many skills to report on, if profiling
+    /// play in phase mode, with this many extra threads per battle thread
+    std::optional<std::size_t> phase_threads = std::nullopt;
+    long log_every = 1;  ///< which battles to write out, if logging
+};
+
+// read a sweep file, of lines like so:
+//     battles 1000            # per cell
+//     level player 1 2 3      # skill level for everyone on the player side
+//     stat enemy evade 5 10   # override a base stat of the enemy side
+//     ai player utility       # the controller for everyone on a side
+// other options (player, enemy, team_size, max_turns) can be given too
+void loadSweep(const std::string& path, Options& opts) {
+    std::ifstream in{ path };
+    if (!in) throw std::invalid_argument("couldn't open '" + path + "'.");
+
+    std::string line;
+    for (int num = 1; std::getline(in, line); num++) {
+        const auto fail = [&](const std::string& what) {
+            return std::invalid_argument(path + ":" + std::to_string(num) + ": " + what);
+        };
+
+        std::istringstream iss{ line.substr(0, line.find('#')) };
+        std::string key;
+        if (!(iss >> key))
+            continue;
+
+        const auto side = [&]() -> bool {
+            std::string which;
+            iss >> which;
+            if (which != "player" && which != "enemy")
+                throw fail("expected 'player' or 'enemy'");
+            return which == "player";
+        };
+
+        if (key == "battles") iss >> opts.battles;
+        else if (key == "team_size") iss >> opts.team_size;
+        else if (key == "max_turns") iss >> opts.max_turns;
+        else if (key == "player") iss >> opts.player.kind >> opts.player.type;
+        else if (key == "enemy") iss >> opts.enemy.kind >> opts.enemy.type;
+        else if (key == "ai") {
+            auto& ai = (side() ? opts.player : opts.enemy).ai;
+            iss >> ai;
+            try {
+                battle::checkAI(ai);
+            } catch (const std::invalid_argument& e) {
+                throw fail(e.what());
+            }
+        }
+        else if (key == "level" || key == "stat") {
+            Axis axis{ side(), {}, {} };
+            if (key == "stat") {
+                iss >> axis.stat;
+                battle::Stats probe{};
+                if (!battle::findBaseStat(probe, axis.stat))
+                    throw fail("unknown stat '" + axis.stat + "'");
+            }
+            for (int v; iss >> v; )
+                axis.values.push_back(v);
+            if (axis.values.empty())
+                throw fail("no values given");
+            if (!iss.eof())
+                throw fail("values must be whole numbers");
+            opts.axes.push_back(std::move(axis));
+            continue;
+        } else
+            throw fail("unknown key '" + key + "'");
+
+        if (iss.fail())
+            throw fail("bad value for '" + key + "'");
+    }
+}
+
+// play `count' battles on the calling thread, tallying them into `stats';
+// `first' is the number of the first of them, for picking which to log
+void simulate(const Options& opts, const Side& blue, const Side& red,
+              long count, battle::Statistics& stats, util::WorkPool* pool,
+              long first, util::LogBuffer* log, battle::DecisionRecorder* recorder)
+{
+    for (long i = 0; i < count; i++) {
+        const auto number = first + i;
+        if (recorder)
+            recorder->beginBattle(static_cast<std::uint32_t>(number));
+
+        std::vector<EntityRef> blues, reds;
+        for (long n = 1; n <= opts.team_size; n++) {
+            blues.push_back(blue.makeEntity(n));
+            reds.push_back(red.makeEntity(n));
+            if (recorder) {
+                const auto actor = static_cast<std::uint8_t>(n - 1);
+                blues.back()->assignController<battle::RecordingController>(
+                    *recorder, battle::Team::Blue, actor);
+                reds.back()->assignController<battle::RecordingController>(
+                    *recorder, battle::Team::Red, actor);
+            }
+        }
+
+        battle::BattleSystem system{ blues, reds };
+        if (opts.phase_threads)
+            system.setPhaseMode(true, pool);
+
+        const auto play = [&] {
+            stats.beginBattle(system);
+            long turn = 0;
+            for (; turn < opts.max_turns && !system.isDone(); turn++)
+                (void)system.doTurn();
+            stats.endBattle(system);
+            return turn;
+        };
+
+        if (log && number % opts.log_every == 0) {
+            battle::LogSink text{ *log };
+            battle::TeeSink both{ stats, text };
+            system.setMessageSink(both);
+            *log << "== battle " << number << " ==\n";
+            const auto turns = play();
+            *log << "== end of battle " << number << " after " << turns << " turns ==\n\n";
+            log->commit();
+        } else {
+            system.setMessageSink(stats);
+            (void)play();
+        }
+
+        if (recorder) {
+            const auto alive = [](const std::vector<EntityRef>& team) {
+                return std::any_of(std::begin(team), std::end(team),
+                                   [](auto& e) { return !e->isDead(); });
+            };
+            std::optional<battle::Team> winner;
+            if (!alive(reds)) winner = battle::Team::Blue;
+            else if (!alive(blues)) winner = battle::Team::Red;
+            recorder->endBattle(winner ? &*winner : nullptr);
+        }
+        battle::stepLuaCollector(battle_collect_kb);
+    }
+}
+
+/// A point on the sweep's grid
+struct Cell {
+    std::vector<int> values;  ///< one per axis
+    Side player;
+    Side enemy;
+};
+
+std::vector<Cell> makeCells(const Options& opts) {
+    std::vector<Cell> cells{ Cell{ {}, opts.player, opts.enemy } };
+    for (auto&& axis : opts.axes) {
+        std::vector<Cell> next;
+        for (auto&& cell : cells) {
+            for (int v : axis.values) {
+                auto c = cell;
+                c.values.push_back(v);
+                axis.apply(axis.player ? c.player : c.enemy, v);
+                next.push_back(std::move(c));
+            }
+        }
+        cells = std::move(next);
+    }
+    return cells;
+}
+
+// run every cell's battles across the threads; returns a tally per cell
+std::vector<battle::Statistics> run(const Options& opts, const std::vector<Cell>& cells,
+                                    std::vector<battle::SkillProfile>& profiles,
+                                    util::LogWriter* log, util::LogWriter* records)
+{
+    const auto chunks = (opts.battles + chunk_size - 1) / chunk_size;
+    const auto items = static_cast<std::size_t>(chunks) * cells.size();
+    std::atomic<std::size_t> next{ 0 };
+
+    // each thread keeps its own tallies (and lua state, and skill details,
+    // which carry over from one cell to the next), with nothing shared until
+    // they're merged at the end
+    std::vector<std::vector<battle::Statistics>> stats(opts.threads);
+    std::vector<std::vector<battle::SkillProfile>> thread_profiles(opts.threads);
+    std::vector<std::exception_ptr> errors(opts.threads);
+    {
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < opts.threads; t++) {
+            threads.emplace_back([&, t] {
+                auto& local = stats[t];
+                local.resize(cells.size());
+                try {
+                    std::optional<util::WorkPool> pool;
+                    if (opts.phase_threads.value_or(0) > 0)
+                        pool.emplace(*opts.phase_threads);
+                    std::optional<util::LogBuffer> text;
+                    if (log)
+                        text.emplace(*log);
+                    std::optional<util::LogBuffer> record_data;
+                    std::optional<battle::DecisionRecorder> recorder;
+                    if (records) {
+                        record_data.emplace(*records);
+                        recorder.emplace(*record_data);
+                    }
+                    if (opts.profile_top)
+                        battle::setSkillProfiling(true);
+                    for (auto i = next++; i < items; i = next++) {
+                        const auto cell = i / static_cast<std::size_t>(chunks);
+                        const auto chunk = static_cast<long>(i) % chunks;
+                        const auto count = std::min(chunk_size, opts.battles - chunk * chunk_size);
+
+                        // seeding by work item keeps runs reproducible,
+                        // whichever thread ends up with it
+                        if (opts.seed)
+                            util::seed(*opts.seed + static_cast<unsigned>(i));
+                        const auto first = static_cast<long>(cell) * opts.battles
+                                         + chunk * chunk_size;
+                        simulate(opts, cells[cell].player, cells[cell].enemy,
+                                 count, local[cell], pool ? &*pool : nullptr,
+                                 first, text ? &*text : nullptr,
+                                 recorder ? &*recorder : nullptr);
+                    }
+                    if (opts.profile_top)
+                        thread_profiles[t] = battle::takeSkillProfiles();
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                    next = items;
+                }
+            });
+        }
+        for (auto&& t : threads)
+            t.join();
+    }
+
+    for (auto&& e : errors)
+        if (e)
+            std::rethrow_exception(e);
+
+    auto result = std::move(stats[0]);
+    for (std::size_t t = 1; t < stats.size(); t++)
+        for (std::size_t c = 0; c < cells.size(); c++)
+            result[c].merge(stats[t][c]);
+    for (auto&& p : thread_profiles)
+        battle::mergeSkillProfiles(profiles, p);
+    return result;
+}
+
+// one row per cell, one column per axis and then the results
+void writeMatrix(std::ostream& os, const Options& opts, const std::vector<Cell>& cells,
+                 const std::vector<battle::Statistics>& stats)
+{
+    for (auto&& axis : opts.axes)
+        os << axis.name() << ",";
+    os << "battles,blue_wins,red_wins,draws,blue_win_rate,mean_turns,p90_turns\n";
+
+    for (std::size_t c = 0; c < cells.size(); c++) {
+        const auto& s = stats[c];
+        for (int v : cells[c].values)
+            os << v << ",";
+        const auto battles = s.battleCount();
+        const auto rate = battles == 0 ? 0.0
+            : static_cast<double>(s.blueWins()) / static_cast<double>(battles);
+        os << battles << ","
+           << s.blueWins() << ","
+           << s.redWins() << ","
+           << battles - s.blueWins() - s.redWins() << ","
+           << rate << ","
+           << s.battleTurns().mean() << ","
+           << s.battleTurns().percentile(90) << "\n";
+    }
+}
+
+int usage(const char* name) {
+    std::cerr << "usage: " << name << " [--battles N] [--threads N] [--team-size N]\n"
+              << "       [--player KIND TYPE] [--enemy KIND TYPE] [--max-turns N] [--seed N]\n"
+              << "       [--sweep FILE] [--trace FILE] [--trace-every N] [--profile-skills N]\n"
+              << "       [--phases N] [--log FILE] [--log-every N] [--player-ai AI]\n"
+              << "       [--enemy-ai AI] [--record FILE]\n"
+              << "Plays NPC-only battles and prints statistics about them as JSON.\n"
+              << "With --sweep, plays `battles' per cell of the grid described in FILE\n"
+              << "instead, and prints a CSV row of results for each cell.\n"
+              << "With --trace, writes a Chrome trace of the engine's hot paths to FILE\n"
+              << "(if built with ENABLE_TRACING), following every Nth turn (default 16).\n"
+              << "With --profile-skills, reports on the N skills whose scripts took\n"
+              << "the longest to run.\n"
+              << "With --phases, resolves turns a phase at a time, with N more threads\n"
+              << "per battle thread helping to choose everyone's actions (N may be 0);\n"
+              << "--max-turns then counts phases.\n"
+              << "With --log, writes a transcript of every Nth battle (default every\n"
+              << "one) to FILE.\n"
+              << "AI is `random' (the default), `utility', which picks the skill and\n"
+              << "target with the best expected damage, or `policy', which asks the\n"
+              << "network in data/ai/default.policy.\n"
+              << "With --record, writes every decision made, with the features the\n"
+              << "policy network would see and how the battle turned out, to FILE\n"
+              << "(the format is described in src/battle/decisionlog.h).\n";
+    return 1;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    std::optional<std::string> sweep = std::nullopt;
+    std::optional<std::string> trace = std::nullopt;
+    long trace_every = 16;
+    std::optional<std::string> log_path = std::nullopt;
+    std::optional<std::string> record_path = std::nullopt;
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            const auto need = [&](int n) { return i + n < argc; };
+            if (arg == "--battles" && need(1))
+                opts.battles = std::stol(argv[++i]);
+            else if (arg == "--threads" && need(1))
+                opts.threads = std::stoul(argv[++i]);
+            else if (arg == "--team-size" && need(1))
+                opts.team_size = std::stol(argv[++i]);
+            else if (arg == "--max-turns" && need(1))
+                opts.max_turns = std::stol(argv[++i]);
+            else if (arg == "--seed" && need(1))
+                opts.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (arg == "--sweep" && need(1))
+                sweep = argv[++i];
+            else if (arg == "--trace" && need(1))
+                trace = argv[++i];
+            else if (arg == "--trace-every" && need(1))
+                trace_every = std::stol(argv[++i]);
+            else if (arg == "--profile-skills" && need(1))
+                opts.profile_top = std::stoul(argv[++i]);
+            else if (arg == "--phases" && need(1))
+                opts.phase_threads = std::stoul(argv[++i]);
+            else if (arg == "--log" && need(1))
+                log_path = argv[++i];
+            else if (arg == "--record" && need(1))
+                record_path = argv[++i];
+            else if (arg == "--log-every" && need(1))
+                opts.log_every = std::stol(argv[++i]);
+            else if (arg == "--player" && need(2)) {
+                opts.player.kind = argv[++i];
+                opts.player.type = argv[++i];
+            } else if (arg == "--player-ai" && need(1))
+                opts.player.ai = battle::checkAI(argv[++i]);
+            else if (arg == "--enemy-ai" && need(1))
+                opts.enemy.ai = battle::checkAI(argv[++i]);
+            else if (arg == "--enemy" && need(2)) {
+                opts.enemy.kind = argv[++i];
+                opts.enemy.type = argv[++i];
+            } else
+                return usage(argv[0]);
+        }
+        if (sweep)
+            loadSweep(*sweep, opts);
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return usage(argv[0]);
+    }
+    if (opts.threads == 0)
+        opts.threads = 1;
+    if (opts.battles < 0 || opts.team_size < 1 || opts.log_every < 1 || trace_every < 1)
+        return usage(argv[0]);
+
+    try {
+        opts.player.load();
+        opts.enemy.load();
+        const auto cells = makeCells(opts);
+        if (trace)
+            util::trace::enable(true, static_cast<unsigned>(trace_every));
+
+        std::ofstream log_file;
+        std::optional<util::LogWriter> log;
+        if (log_path) {
+            log_file.open(*log_path);
+            if (!log_file)
+                throw std::runtime_error("couldn't open '" + *log_path + "'.");
+            log.emplace(log_file);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<battle::SkillProfile> profiles;
+        std::ofstream record_file;
+        std::optional<util::LogWriter> records;
+        if (record_path) {
+            record_file.open(*record_path, std::ios::binary);
+            if (!record_file)
+                throw std::runtime_error("couldn't open '" + *record_path + "'.");
+            records.emplace(record_file);
+        }
+
+        const auto stats = run(opts, cells, profiles, log ? &*log : nullptr,
+                               records ? &*records : nullptr);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const auto seconds = elapsed.count();
+        const auto total = static_cast<double>(opts.battles) * static_cast<double>(cells.size());
+        const auto per_hour = seconds > 0 ? total / seconds * 3600 : 0.0;
+
+        if (sweep) {
+            writeMatrix(std::cout, opts, cells, stats);
+            std::cerr << cells.size() << " cells in " << seconds << "s ("
+                      << per_hour << " battles/hour)\n";
+        } else {
+            std::cout << "{\"threads\":" << opts.threads
+                      << ",\"team_size\":" << opts.team_size
+                      << ",\"seconds\":" << seconds
+                      << ",\"battles_per_hour\":" << per_hour
+                      << ",\"stats\":";
+            stats[0].write(std::cout);
+            std::cout << "}\n";
+        }
+
+        if (opts.profile_top)
+            battle::writeSkillProfiles(std::cerr, std::move(profiles), opts.profile_top);
+
+        if (trace) {
+            std::ofstream out{ *trace };
+            if (!out)
+                throw std::runtime_error("couldn't open '" + *trace + "'.");
+            util::trace::write(out);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "util/dense.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace util {
+
+
+DenseLayer::DenseLayer(std::size_t inputs, std::size_t outputs,
+                       const std::vector<float>& weights, std::vector<float> b,
+                       Activation activation, Precision precision)
+    : num_inputs{ inputs }
+    , num_outputs{ outputs }
+    , stride{ (outputs + lanes - 1) / lanes * lanes }
+    , act{ activation }
+    , prec{ precision }
+    , bias{ std::move(b) }
+{
+    if (inputs == 0 || outputs == 0)
+        throw std::invalid_argument("DenseLayer: no inputs or outputs");
+    if (weights.size() != inputs * outputs)
+        throw std::invalid_argument("DenseLayer: expected " + std::to_string(inputs * outputs)
+                                    + " weights, got " + std::to_string(weights.size()));
+    if (bias.size() != outputs)
+        throw std::invalid_argument("DenseLayer: expected " + std::to_string(outputs)
+                                    + " biases, got " + std::to_string(bias.size()));
+
+    // transpose to input-major; the padding stays zero, so it sums to nothing
+    const auto weight = [&](std::size_t i, std::size_t o) { return weights[o * inputs + i]; };
+    switch (prec) {
+    case Precision::Float:
+        float_weights.assign(inputs * stride, 0.0f);
+        for (std::size_t i = 0; i < inputs; i++)
+            for (std::size_t o = 0; o < outputs; o++)
+                float_weights[i * stride + o] = weight(i, o);
+        break;
+
+    case Precision::Int8: {
+        float largest = 0.0f;
+        for (float w : weights)
+            largest = std::max(largest, std::abs(w));
+        weight_scale = largest > 0.0f ? largest / 127.0f : 1.0f;
+
+        // a row per pair of inputs, with each output's two weights side
+        // by side; an odd input out is paired with a zero one
+        int_weights.assign((inputs + 1) / 2 * 2 * stride, 0);
+        for (std::size_t i = 0; i < inputs; i++)
+            for (std::size_t o = 0; o < outputs; o++)
+                int_weights[i / 2 * 2 * stride + 2 * o + i % 2] = static_cast<std::int8_t>(
+                    std::lround(weight(i, o) / weight_scale));
+        break;
+    }
+    }
+}
+
+void DenseLayer::apply(const float* in, float* out, Workspace& ws) const {
+    switch (prec) {
+    case Precision::Float: {
+        // four inputs per pass over the sums, to keep the loads and stores
+        // down; every pass is one long multiply-add along the outputs
+        auto& sums = ws.sums;
+        sums.assign(stride, 0.0f);
+        std::size_t i = 0;
+        for (; i + 4 <= num_inputs; i += 4) {
+            const float x0 = in[i], x1 = in[i + 1], x2 = in[i + 2], x3 = in[i + 3];
+            const float* w = &float_weights[i * stride];
+            for (std::size_t o = 0; o < stride; o++)
+                sums[o] += x0 * w[o] + x1 * w[o + stride]
+                         + x2 * w[o + 2 * stride] + x3 * w[o + 3 * stride];
+        }
+        for (; i < num_inputs; i++) {
+            const float x = in[i];
+            const float* w = &float_weights[i * stride];
+            for (std::size_t o = 0; o < stride; o++)
+                sums[o] += x * w[o];
+        }
+        for (std::size_t o = 0; o < num_outputs; o++)
+            out[o] = sums[o] + bias[o];
+        break;
+    }
+
+    case Precision::Int8: {
+        float largest = 0.0f;
+        for (std::size_t i = 0; i < num_inputs; i++)
+            largest = std::max(largest, std::abs(in[i]));
+        const float input_scale = largest > 0.0f ? largest / 127.0f : 1.0f;
+
+        const std::size_t pairs = (num_inputs + 1) / 2;
+        auto& q = ws.int_inputs;
+        q.assign(2 * pairs, 0);
+        // rounded by hand, as a call to lround per input costs as much as
+        // the sums do for small layers; it's all within +-127 anyway
+        for (std::size_t i = 0; i < num_inputs; i++)
+            q[i] = static_cast<std::int16_t>(in[i] / input_scale + (in[i] < 0.0f ? -0.5f : 0.5f));
+
+        // multiply 16-bit inputs by 16-bit weights and add neighbouring
+        // products into 32-bit sums, a pair of inputs at a time, which x86
+        // does in one instruction (pmaddwd); two products of int8s can't
+        // overflow an int32
+        auto& sums = ws.int_sums;
+        sums.assign(stride, 0);
+#ifdef __SSE2__
+        // a block of `lanes' outputs at a time, its sums kept in registers
+        // all the way down the rows
+        static_assert(lanes == 16, "the int8 kernel takes 16 outputs at a time");
+        const auto widen = [](__m128i lo_or_hi) { return _mm_srai_epi16(lo_or_hi, 8); };
+        for (std::size_t o = 0; o < stride; o += lanes) {
+            __m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+            const std::int8_t* w = &int_weights[2 * o];
+            for (std::size_t p = 0; p < pairs; p++, w += 2 * stride) {
+                std::int32_t pair;
+                std::memcpy(&pair, &q[2 * p], sizeof pair);
+                const auto x = _mm_set1_epi32(pair);
+                const auto w0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+                const auto w1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + 16));
+                s0 = _mm_add_epi32(s0, _mm_madd_epi16(widen(_mm_unpacklo_epi8(w0, w0)), x));
+                s1 = _mm_add_epi32(s1, _mm_madd_epi16(widen(_mm_unpackhi_epi8(w0, w0)), x));
+                s2 = _mm_add_epi32(s2, _mm_madd_epi16(widen(_mm_unpacklo_epi8(w1, w1)), x));
+                s3 = _mm_add_epi32(s3, _mm_madd_epi16(widen(_mm_unpackhi_epi8(w1, w1)), x));
+            }
+            auto* out_sums = reinterpret_cast<__m128i*>(&sums[o]);
+            _mm_storeu_si128(out_sums, s0);
+            _mm_storeu_si128(out_sums + 1, s1);
+            _mm_storeu_si128(out_sums + 2, s2);
+            _mm_storeu_si128(out_sums + 3, s3);
+        }
+#else
+        for (std::size_t p = 0; p < pairs; p++) {
+            const std::int32_t x0 = q[2 * p], x1 = q[2 * p + 1];
+            const std::int8_t* w = &int_weights[p * 2 * stride];
+            for (std::size_t o = 0; o < stride; o++)
+                sums[o] += x0 * w[2 * o] + x1 * w[2 * o + 1];
+        }
+#endif
+
+        const float scale = weight_scale * input_scale;
+        for (std::size_t o = 0; o < num_outputs; o++)
+            out[o] = static_cast<float>(sums[o]) * scale + bias[o];
+        break;
+    }
+    }
+
+    if (act == Activation::Relu)
+        for (std::size_t o = 0; o < num_outputs; o++)
+            out[o] = std::max(out[o], 0.0f);
+}
+
+
+}
@@ -0,0 +1,73 @@
+#ifndef DENSE_H_INCLUDED
+#define DENSE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util {
+
+
+/// One fully connected layer of a neural network: out = act(W in + b)
+///
+/// Weights are kept input-major (a row of every output's weight for each
+/// input) with the rows padded out to a multiple of `lanes', so the inner
+/// loop runs along the outputs with no reduction or odd tail to get in the
+/// way, and the compiler turns it into straight SIMD multiply-adds (at -O3,
+/// or -O2 with -ftree-vectorize).
+///
+/// An int8 layer quantises its weights once, up front, with one scale for
+/// the whole layer, and its inputs as they come, likewise; the sums are
+/// then done in int32 and scaled back at the end. Its rows hold a pair of
+/// inputs each, laid out for x86's pairwise 16-bit multiply-add (SSE2,
+/// with plain loops elsewhere). That's a quarter of the memory of floats,
+/// and usually well within a percent of their results; what it's for is
+/// the memory, though: it's only a little quicker than float on x86, and
+/// may well be slower without SSE2.
+class DenseLayer {
+public:
+    enum class Activation { Linear, Relu };
+    enum class Precision { Float, Int8 };
+
+    /// Rows of weights are padded out to a multiple of this many outputs
+    static constexpr std::size_t lanes = 16;
+
+    /// `weights' is given output-major, as it's usually written down: all
+    /// of the first output's weights, then the second's, and so on.
+    /// Throws std::invalid_argument if the sizes don't match up.
+    DenseLayer(std::size_t inputs, std::size_t outputs,
+               const std::vector<float>& weights, std::vector<float> bias,
+               Activation activation, Precision precision);
+
+    [[nodiscard]] std::size_t inputs() const noexcept { return num_inputs; }
+    [[nodiscard]] std::size_t outputs() const noexcept { return num_outputs; }
+    [[nodiscard]] Precision precision() const noexcept { return prec; }
+
+    /// Somewhere for a layer to work; keep one around rather than making
+    /// one per evaluation, and don't share one between threads
+    struct Workspace {
+        std::vector<float> sums;
+        std::vector<std::int32_t> int_sums;
+        std::vector<std::int16_t> int_inputs;
+    };
+
+    /// Run the layer on `in' (`inputs' long), writing `outputs' values to `out'
+    void apply(const float* in, float* out, Workspace& ws) const;
+
+private:
+    std::size_t num_inputs;
+    std::size_t num_outputs;
+    std::size_t stride;  ///< outputs, rounded up to a multiple of lanes
+    Activation act;
+    Precision prec;
+
+    std::vector<float> float_weights;        ///< for float layers
+    std::vector<std::int8_t> int_weights;    ///< for int8 layers, paired
+    float weight_scale = 1.0f;               ///< what one int8 step is worth
+    std::vector<float> bias;
+};
+
+
+}
+
+#endif // DENSE_H_INCLUDED
@@ -0,0 +1,135 @@
+#ifndef HISTOGRAM_H_INCLUDED
+#define HISTOGRAM_H_INCLUDED
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace util {
+
+
+/// A histogram of non-negative integers, in the style of HdrHistogram
+///
+/// Values below 2^precision get a bucket each; above that, each power of two
+/// is split into 2^(precision - 1) equal buckets, so anything read back out
+/// is within 2^-(precision - 1) (about 1.6%) of what went in. Buckets are
+/// only allocated up to the largest value seen, so a histogram of small
+/// numbers stays small. Recording a value is a couple of shifts and an add.
+///
+/// Not thread safe; give each thread its own, and `merge' them afterwards.
+class Histogram {
+public:
+    static constexpr unsigned precision = 7;
+
+    /// Record `count' occurrences of `value'
+    void add(std::uint64_t value, std::uint64_t count = 1) {
+        const auto i = bucket(value);
+        if (i >= counts.size())
+            counts.resize(i + 1, 0);
+        counts[i] += count;
+
+        if (total == 0 || value < lowest) lowest = value;
+        if (total == 0 || value > highest) highest = value;
+        total += count;
+        summed += value * count;
+    }
+
+    /// Fold another histogram's values into this one
+    void merge(const Histogram& other) {
+        if (other.total == 0)
+            return;
+        if (other.counts.size() > counts.size())
+            counts.resize(other.counts.size(), 0);
+        for (std::size_t i = 0; i < other.counts.size(); i++)
+            counts[i] += other.counts[i];
+
+        if (total == 0 || other.lowest < lowest) lowest = other.lowest;
+        if (total == 0 || other.highest > highest) highest = other.highest;
+        total += other.total;
+        summed += other.summed;
+    }
+
+    /// How many values were recorded
+    [[nodiscard]] std::uint64_t count() const noexcept { return total; }
+    /// The exact sum of the values recorded
+    [[nodiscard]] std::uint64_t sum() const noexcept { return summed; }
+    /// The exact smallest value recorded (0 if empty)
+    [[nodiscard]] std::uint64_t min() const noexcept { return lowest; }
+    /// The exact largest value recorded (0 if empty)
+    [[nodiscard]] std::uint64_t max() const noexcept { return highest; }
+
+    /// The exact mean of the values recorded (0 if empty)
+    [[nodiscard]] double mean() const noexcept {
+        return total == 0 ? 0.0
+            : static_cast<double>(summed) / static_cast<double>(total);
+    }
+
+    /// The value that `p' percent of values are less than or equal to,
+    /// to within the histogram's precision (0 if empty)
+    [[nodiscard]] std::uint64_t percentile(double p) const noexcept {
+        if (total == 0)
+            return 0;
+        p = std::clamp(p, 0.0, 100.0);
+        // the smallest rank with at least `p' percent at or below it; multiply
+        // before dividing, so whole percentiles come out exact
+        auto rank = static_cast<std::uint64_t>(
+            std::ceil(p * static_cast<double>(total) / 100.0));
+        rank = std::clamp<std::uint64_t>(rank, 1, total);
+
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::clamp(highestEquivalent(i), lowest, highest);
+        }
+        return highest;
+    }
+
+private:
+    static constexpr std::uint64_t exact = std::uint64_t{ 1 } << precision;
+    static constexpr std::uint64_t half = exact / 2;
+
+    std::vector<std::uint64_t> counts = {};
+    std::uint64_t total = 0;
+    std::uint64_t summed = 0;
+    std::uint64_t lowest = 0;
+    std::uint64_t highest = 0;
+
+    static unsigned msb(std::uint64_t value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned bit = 0;
+        while (value >>= 1)
+            bit++;
+        return bit;
+#endif
+    }
+
+    static std::size_t bucket(std::uint64_t value) noexcept {
+        if (value < exact)
+            return static_cast<std::size_t>(value);
+        const auto shift = msb(value) - precision + 1;
+        const auto sub = value >> shift;  // in [half, exact)
+        return static_cast<std::size_t>(exact + (shift - 1) * half + (sub - half));
+    }
+
+    static std::uint64_t highestEquivalent(std::size_t index) noexcept {
+        if (index < exact)
+            return index;
+        const auto offset = index - exact;
+        const auto shift = offset / half + 1;
+        const auto sub = offset % half + half;
+        if (shift + precision >= 64)
+            return std::numeric_limits<std::uint64_t>::max();
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+
+} // namespace util
+
+#endif // HISTOGRAM_H_INCLUDED
@@ -0,0 +1,99 @@
+#include "util/logwriter.h"
+
+#include <utility>
+
+namespace util {
+
+
+LogWriter::LogWriter(std::ostream& os)
+    : os{ os }
+    , thread{ [this]{ run(); } }
+{
+}
+
+LogWriter::~LogWriter() {
+    {
+        std::lock_guard lock{ mutex };
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    os.flush();
+}
+
+void LogWriter::flush() {
+    std::unique_lock lock{ mutex };
+    ready.wait(lock, [this]{ return queue.empty() && !writing; });
+    // the writer thread can't start on anything while we hold the lock
+    os.flush();
+}
+
+std::uint64_t LogWriter::written() const {
+    std::lock_guard lock{ mutex };
+    return bytes;
+}
+
+std::string LogWriter::swap(std::string&& block, std::size_t capacity) {
+    std::string empty;
+    {
+        std::unique_lock lock{ mutex };
+        if (!block.empty()) {
+            ready.wait(lock, [this]{ return queue.size() < max_queued; });
+            queue.push_back(std::move(block));
+        }
+        if (!spare.empty()) {
+            empty = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    wake.notify_one();
+
+    empty.clear();
+    empty.reserve(capacity);
+    return empty;
+}
+
+void LogWriter::run() {
+    std::unique_lock lock{ mutex };
+    for (;;) {
+        wake.wait(lock, [this]{ return stopping || !queue.empty(); });
+        if (queue.empty())
+            return;  // stopping, and nothing left to write
+
+        auto block = std::move(queue.front());
+        queue.pop_front();
+        writing = true;
+
+        lock.unlock();
+        os.write(block.data(), static_cast<std::streamsize>(block.size()));
+        lock.lock();
+
+        writing = false;
+        bytes += block.size();
+        block.clear();
+        spare.push_back(std::move(block));
+        ready.notify_all();
+    }
+}
+
+
+LogBuffer::LogBuffer(LogWriter& writer, std::size_t capacity)
+    : writer{ writer }
+    , capacity{ capacity }
+{
+    // leave some slack, so a record that runs over doesn't have to regrow it
+    text.reserve(capacity + capacity / 4);
+}
+
+LogBuffer::~LogBuffer() {
+    if (!text.empty())
+        writer.swap(std::move(text), 0);
+}
+
+void LogBuffer::flush() {
+    if (!text.empty())
+        text = writer.swap(std::move(text), capacity + capacity / 4);
+}
+
+
+}
@@ -0,0 +1,127 @@
+#ifndef LOGWRITER_H_INCLUDED
+#define LOGWRITER_H_INCLUDED
+
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+
+
+/// Writes text to a stream from a thread of its own
+///
+/// Text is formatted into LogBuffers, one per producing thread, which hand
+/// over what they've got in big blocks; the writer thread then does the
+/// actual output while the producers carry on. Blocks go back and forth
+/// rather than being freed, so once things are going logging doesn't
+/// allocate. Text from different buffers only interleaves where they were
+/// `commit'ted, so commit at the end of whatever should stay in one piece.
+///
+/// Should the stream fall too far behind, handing over blocks waits for it.
+class LogWriter {
+public:
+    /// The most blocks waiting to be written before producers have to wait
+    static constexpr std::size_t max_queued = 64;
+
+    /// The stream must outlive the writer, and not be used by anyone else
+    /// until it's gone (or between `flush' and the next block handed over)
+    explicit LogWriter(std::ostream& os);
+
+    /// Writes out everything already handed over before stopping
+    ~LogWriter();
+
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+
+    /// Wait for everything handed over so far to be written out, and flush
+    /// the stream (anything still in a LogBuffer isn't included)
+    void flush();
+
+    /// How many bytes have been written out so far
+    [[nodiscard]] std::uint64_t written() const;
+
+private:
+    friend class LogBuffer;
+
+    /// Hand over a block of text to be written, getting back an empty one
+    /// with (at least) `capacity' reserved
+    std::string swap(std::string&& block, std::size_t capacity);
+
+    std::ostream& os;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;   ///< something to write, or stopping
+    std::condition_variable ready;  ///< room in the queue, or all written
+    std::deque<std::string> queue;  ///< blocks waiting to be written
+    std::vector<std::string> spare; ///< written blocks, to be reused
+    std::uint64_t bytes = 0;
+    bool writing = false;
+    bool stopping = false;
+
+    std::thread thread;  // last, so the rest is ready by the time it starts
+
+    void run();
+};
+
+/// Somewhere to format text for a LogWriter; give each thread its own
+class LogBuffer {
+public:
+    static constexpr std::size_t default_capacity = 64 * 1024;  ///< bytes
+
+    /// `capacity' is how much to collect before handing it over
+    explicit LogBuffer(LogWriter& writer, std::size_t capacity = default_capacity);
+
+    /// Hands over whatever's left
+    ~LogBuffer();
+
+    LogBuffer(const LogBuffer&) = delete;
+    LogBuffer& operator=(const LogBuffer&) = delete;
+
+    LogBuffer& operator<<(std::string_view s) {
+        text.append(s);
+        return *this;
+    }
+
+    LogBuffer& operator<<(char c) {
+        text.push_back(c);
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<
+        std::is_integral_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>>>
+    LogBuffer& operator<<(T value) {
+        char digits[24];
+        const auto end = std::to_chars(digits, digits + sizeof digits, value).ptr;
+        text.append(digits, static_cast<std::size_t>(end - digits));
+        return *this;
+    }
+
+    /// Mark the end of something that should be written out in one piece;
+    /// the buffer is handed over here once it's full enough
+    void commit() {
+        if (text.size() >= capacity)
+            flush();
+    }
+
+    /// Hand over everything so far, full or not
+    void flush();
+
+private:
+    LogWriter& writer;
+    std::size_t capacity;
+    std::string text;
+};
+
+
+}
+
+#endif // LOGWRITER_H_INCLUDED
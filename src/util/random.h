@@ -10,8 +10,10 @@ namespace util {
 
 
 namespace _detail::random {
+    // one generator per thread, so battles run on different threads never
+    // contend (or race) on it
     inline auto& generator() {
-        static auto gen = [](){
+        thread_local auto gen = [](){
             std::random_device dev;
             // TODO: better random device initialization?
             // TODO: generate different random functions for different subsystems?
@@ -21,6 +23,32 @@ namespace _detail::random {
     }
 }
 
+// Reseed the calling thread's generator, so the following sequence of random
+// numbers is reproducible (e.g. to compare two runs of the same battle).
+inline void seed(std::mt19937::result_type value) {
+    _detail::random::generator().seed(value);
+}
+
+// Reseed the calling thread's generator for as long as this is around, and put
+// it back how it was afterwards. Work handed out to other threads can then draw
+// the same numbers no matter which thread ends up doing it.
+class SeedScope {
+public:
+    explicit SeedScope(std::mt19937::result_type value)
+        : saved{ _detail::random::generator() }
+    {
+        seed(value);
+    }
+
+    ~SeedScope() { _detail::random::generator() = saved; }
+
+    SeedScope(const SeedScope&) = delete;
+    SeedScope& operator=(const SeedScope&) = delete;
+
+private:
+    std::mt19937 saved;
+};
+
 // Generates a random number of type (C = T union U) in the given range.
 // Given a common type "C", then:
 //  - if "C" is integral, return a value in range [min, max]
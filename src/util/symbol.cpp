@@ -0,0 +1,63 @@
+#include "util/symbol.h"
+
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace util {
+
+
+namespace {
+    struct Table {
+        std::shared_mutex mutex;
+        std::deque<std::string> strings{ std::string{} };  // never moved once added
+        std::unordered_map<std::string_view, Symbol::Id> ids{ { strings.front(), 0 } };
+    };
+
+    Table& table() {
+        static Table t;
+        return t;
+    }
+}
+
+Symbol::Symbol(std::string_view text) {
+    auto& t = table();
+    {
+        std::shared_lock lock{ t.mutex };
+        if (auto it = t.ids.find(text); it != t.ids.end()) {
+            value = it->second;
+            return;
+        }
+    }
+
+    std::unique_lock lock{ t.mutex };
+    if (auto it = t.ids.find(text); it != t.ids.end()) {
+        value = it->second;
+        return;
+    }
+    if (t.strings.size() > std::numeric_limits<Id>::max())
+        throw std::length_error("Symbol: too many symbols");
+
+    const auto id = static_cast<Id>(t.strings.size());
+    t.strings.emplace_back(text);
+    t.ids.emplace(t.strings.back(), id);
+    value = id;
+}
+
+const std::string& Symbol::str() const noexcept {
+    auto& t = table();
+    std::shared_lock lock{ t.mutex };
+    return t.strings[value];
+}
+
+std::size_t Symbol::count() noexcept {
+    auto& t = table();
+    std::shared_lock lock{ t.mutex };
+    return t.strings.size();
+}
+
+
+}
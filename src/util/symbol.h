@@ -0,0 +1,62 @@
+#ifndef SYMBOL_H_INCLUDED
+#define SYMBOL_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+
+/// A string interned in a table shared by every thread
+///
+/// Only the 32-bit id is carried around, so copying, comparing and hashing a
+/// symbol are as cheap as they are for an int; the text is only looked up
+/// when it's wanted for display. Interning takes a lock, so make the symbols
+/// up front (e.g. when loading) rather than in the middle of a battle.
+///
+/// Ids are handed out in the order strings are first seen, so don't let them
+/// decide the order of anything that's written out; `str' is stable for that.
+class Symbol {
+public:
+    using Id = std::uint32_t;
+
+    /// The empty string, which is always id 0
+    constexpr Symbol() noexcept = default;
+
+    explicit Symbol(std::string_view text);
+    explicit Symbol(const std::string& text) : Symbol{ std::string_view{ text } } {}
+    explicit Symbol(const char* text) : Symbol{ std::string_view{ text } } {}
+
+    [[nodiscard]] constexpr Id id() const noexcept { return value; }
+
+    /// The interned text; the reference lasts as long as the program
+    [[nodiscard]] const std::string& str() const noexcept;
+
+    /// How many distinct strings have been interned
+    [[nodiscard]] static std::size_t count() noexcept;
+
+    friend constexpr bool operator==(Symbol a, Symbol b) noexcept { return a.value == b.value; }
+    friend constexpr bool operator!=(Symbol a, Symbol b) noexcept { return a.value != b.value; }
+    /// Orders by id, not alphabetically; good for maps, not for output
+    friend constexpr bool operator<(Symbol a, Symbol b) noexcept { return a.value < b.value; }
+
+private:
+    Id value = 0;
+};
+
+
+}
+
+namespace std {
+    template <>
+    struct hash<util::Symbol> {
+        std::size_t operator()(util::Symbol s) const noexcept {
+            return std::hash<util::Symbol::Id>{}(s.id());
+        }
+    };
+}
+
+#endif // SYMBOL_H_INCLUDED
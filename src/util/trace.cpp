@@ -0,0 +1,112 @@
+#include "util/trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util::trace {
+
+namespace {
+
+    using _detail::Buffer;
+
+    // buffers outlive their threads, so a thread's events can be written out
+    // after it has finished
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Buffer>> buffers;
+
+        // for working out how long a tick is, come export time
+        const Ticks ticks_start = now();
+        const std::chrono::steady_clock::time_point clock_start =
+            std::chrono::steady_clock::now();
+
+        std::shared_ptr<Buffer> add() {
+            std::lock_guard lock{ mutex };
+            auto b = std::make_shared<Buffer>();
+            b->thread = buffers.size() + 1;
+            buffers.push_back(b);
+            return b;
+        }
+    };
+
+    Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    void writeName(std::ostream& os, const char* name) {
+        os << '"';
+        for (; *name; name++) {
+            if (*name == '"' || *name == '\\')
+                os << '\\';
+            os << *name;
+        }
+        os << '"';
+    }
+
+}
+
+
+Buffer& _detail::addLocalBuffer() {
+    local_buffer = registry().add().get();
+    return *local_buffer;
+}
+
+void write(std::ostream& os) {
+    using us = std::chrono::duration<double, std::micro>;
+
+    auto& r = registry();
+    std::lock_guard lock{ r.mutex };
+
+    const us elapsed = std::chrono::steady_clock::now() - r.clock_start;
+    const auto ticks = now() - r.ticks_start;
+    const auto us_per_tick = ticks == 0 ? 0.0 : elapsed.count() / static_cast<double>(ticks);
+
+    // timestamps are relative to the earliest event, to keep them readable
+    auto epoch = std::numeric_limits<Ticks>::max();
+    for (auto&& b : r.buffers) {
+        const auto first = b->next > buffer_size ? b->next - buffer_size : 0;
+        for (auto i = first; i < b->next; i++)
+            epoch = std::min(epoch, b->events[i % buffer_size].start);
+    }
+
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const char* sep = "";
+    for (auto&& b : r.buffers) {
+        os << sep << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+           << b->thread << ",\"args\":{\"name\":\"thread " << b->thread << "\"}}";
+        sep = ",";
+
+        const auto first = b->next > buffer_size ? b->next - buffer_size : 0;
+        for (auto i = first; i < b->next; i++) {
+            const auto& e = b->events[i % buffer_size];
+            os << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << b->thread << ",\"name\":";
+            writeName(os, e.name);
+            os << ",\"ts\":" << static_cast<double>(e.start - epoch) * us_per_tick
+               << ",\"dur\":" << static_cast<double>(e.duration) * us_per_tick << '}';
+        }
+    }
+    os << "]}\n";
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void clear() noexcept {
+    auto& r = registry();
+    std::lock_guard lock{ r.mutex };
+    for (auto&& b : r.buffers)
+        b->next = 0;
+}
+
+
+}
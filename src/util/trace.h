@@ -0,0 +1,226 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define TRACE_USE_TSC 1
+#endif
+
+// Scoped trace points, for seeing where the time in a turn goes.
+//
+// TRACE_SCOPE("name") times the rest of the enclosing block, and records it
+// in a ring buffer belonging to the calling thread; `util::trace::write' dumps
+// every thread's buffer as Chrome trace JSON (which Perfetto reads too).
+// The trace points only exist when built with -DENABLE_TRACING=ON; otherwise
+// they compile to nothing. Even then, nothing is recorded until tracing is
+// switched on with `util::trace::enable'.
+//
+// Reading the clock is most of what a trace point costs, so rather than
+// every turn, one turn in so many is traced: TRACE_TURN("name") marks where
+// a turn starts, and a TRACE_SCOPE outside of a traced turn costs a single
+// thread-local load. Work a turn hands out to other threads goes untraced
+// unless they TRACE_FOLLOW the turn; trace points outside of any turn are
+// always recorded.
+//
+// The name must be a string literal (or otherwise outlive the trace).
+
+namespace util::trace {
+
+
+/// A timestamp, in ticks of whatever clock is cheapest to read
+/// (the TSC on x86, otherwise the steady clock); converted at export.
+using Ticks = std::uint64_t;
+
+[[nodiscard]] inline Ticks now() noexcept {
+#ifdef TRACE_USE_TSC
+    return __rdtsc();
+#else
+    return static_cast<Ticks>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+/// How many events each thread keeps; older ones are overwritten
+inline constexpr std::size_t buffer_size = std::size_t{ 1 } << 16;
+
+namespace _detail {
+    inline std::atomic<bool> enabled{ false };
+    inline std::atomic<unsigned> every{ 1 };
+
+    /// Whether the calling thread is in a turn, and if so, if it's traced
+    enum class TurnState : unsigned char { none, skipped, traced };
+    inline thread_local TurnState turn = TurnState::none;
+    inline thread_local unsigned turns_to_skip = 0;
+
+    struct Event {
+        const char* name;
+        Ticks start;
+        Ticks duration;
+    };
+
+    /// One thread's events; the oldest are overwritten once it fills up
+    struct Buffer {
+        std::vector<Event> events = std::vector<Event>(buffer_size);
+        std::size_t next = 0;  ///< total events ever recorded
+        std::size_t thread;    ///< an id for the trace, counting from 1
+    };
+
+    /// The calling thread's buffer, once it has recorded anything; owned by
+    /// the registry in trace.cpp, so it outlives the thread
+    inline thread_local Buffer* local_buffer = nullptr;
+
+    /// Give the calling thread a buffer, and set `local_buffer' to it
+    Buffer& addLocalBuffer();
+}
+
+/// Start (or stop) recording trace events, from one turn in every `every'
+inline void enable(bool on = true, unsigned every = 1) noexcept {
+    _detail::every.store(every == 0 ? 1 : every, std::memory_order_relaxed);
+    _detail::enabled.store(on, std::memory_order_relaxed);
+}
+
+[[nodiscard]] inline bool enabled() noexcept {
+    return _detail::enabled.load(std::memory_order_relaxed);
+}
+
+/// Whether the calling thread is in a turn that's being traced
+[[nodiscard]] inline bool tracingTurn() noexcept {
+    return _detail::turn == _detail::TurnState::traced;
+}
+
+/// Whether a trace point on the calling thread gets recorded: in a traced
+/// turn, or outside of any turn while tracing is on
+[[nodiscard]] inline bool recording() noexcept {
+    using _detail::TurnState;
+    const auto turn = _detail::turn;
+    return turn == TurnState::traced || (turn == TurnState::none && enabled());
+}
+
+/// Add an event to the calling thread's buffer
+inline void record(const char* name, Ticks start, Ticks end) noexcept {
+    auto* b = _detail::local_buffer;
+    if (!b)
+        b = &_detail::addLocalBuffer();
+    b->events[b->next % buffer_size] = _detail::Event{ name, start, end - start };
+    b->next++;
+}
+
+/// Write out every thread's events as a Chrome trace JSON object.
+/// Don't call this while traced threads are still running.
+void write(std::ostream& os);
+
+/// Throw away every thread's events
+/// Don't call this while traced threads are still running.
+void clear() noexcept;
+
+/// Records the time between its construction and destruction
+class Scope {
+public:
+    explicit Scope(const char* name) noexcept
+        : name{ recording() ? name : nullptr }
+    {
+        if (this->name)
+            start = now();
+    }
+
+    ~Scope() {
+        if (name)
+            record(name, start, now());
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name;
+    Ticks start = 0;
+};
+
+/// A Scope that starts a turn, and decides whether the turn is traced
+class Turn {
+public:
+    explicit Turn(const char* name) noexcept
+        : outer{ _detail::turn }
+    {
+        using _detail::TurnState;
+        if (outer == TurnState::none && enabled()) {
+            if (_detail::turns_to_skip == 0) {
+                _detail::turns_to_skip = _detail::every.load(std::memory_order_relaxed) - 1;
+                _detail::turn = TurnState::traced;
+            } else {
+                _detail::turns_to_skip--;
+                _detail::turn = TurnState::skipped;
+            }
+        }
+        if (tracingTurn()) {
+            this->name = name;
+            start = now();
+        }
+    }
+
+    ~Turn() {
+        if (name)
+            record(name, start, now());
+        _detail::turn = outer;
+    }
+
+    Turn(const Turn&) = delete;
+    Turn& operator=(const Turn&) = delete;
+
+private:
+    _detail::TurnState outer;
+    const char* name = nullptr;
+    Ticks start = 0;
+};
+
+/// Has the calling thread trace (or not) along with another thread's turn,
+/// while doing work handed out by it; `traced' is what `tracingTurn' said
+/// on that thread
+class Follow {
+public:
+    explicit Follow(bool traced) noexcept
+        : outer{ _detail::turn }
+    {
+        using _detail::TurnState;
+        _detail::turn = traced ? TurnState::traced : TurnState::skipped;
+    }
+
+    ~Follow() {
+        _detail::turn = outer;
+    }
+
+    Follow(const Follow&) = delete;
+    Follow& operator=(const Follow&) = delete;
+
+private:
+    _detail::TurnState outer;
+};
+
+
+} // namespace util::trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef BATTLE_TRACING
+#define TRACE_SCOPE(name) \
+    ::util::trace::Scope TRACE_CONCAT(trace_scope_, __LINE__){ name }
+#define TRACE_TURN(name) \
+    ::util::trace::Turn TRACE_CONCAT(trace_turn_, __LINE__){ name }
+#define TRACE_TRACING_TURN() ::util::trace::tracingTurn()
+#define TRACE_FOLLOW(traced) \
+    ::util::trace::Follow TRACE_CONCAT(trace_follow_, __LINE__){ traced }
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_TURN(name) ((void)0)
+#define TRACE_TRACING_TURN() false
+#define TRACE_FOLLOW(traced) ((void)(traced))
+#endif
+
+#endif // TRACE_H_INCLUDED
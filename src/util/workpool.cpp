@@ -0,0 +1,97 @@
+#include "util/workpool.h"
+
+#include <utility>
+
+namespace util {
+
+
+WorkPool::WorkPool(std::size_t threads) {
+    workers.reserve(threads);
+    try {
+        for (std::size_t i = 0; i < threads; i++)
+            workers.emplace_back([this]{ work(); });
+    } catch (...) {
+        stop();
+        throw;
+    }
+}
+
+WorkPool::~WorkPool() {
+    stop();
+}
+
+void WorkPool::stop() noexcept {
+    {
+        std::lock_guard lock{ mutex };
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers)
+        if (t.joinable())
+            t.join();
+}
+
+void WorkPool::run(std::size_t n, const std::function<void(std::size_t)>& f) {
+    if (n == 0)
+        return;
+
+    {
+        std::lock_guard lock{ mutex };
+        task = &f;
+        count = n;
+        next.store(0, std::memory_order_relaxed);
+        error = nullptr;
+        busy = workers.size();
+        batch++;
+    }
+    wake.notify_all();
+
+    drain();
+
+    std::unique_lock lock{ mutex };
+    done.wait(lock, [this]{ return busy == 0; });
+    task = nullptr;
+    if (error)
+        std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void WorkPool::work() noexcept {
+    std::size_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock lock{ mutex };
+            wake.wait(lock, [&]{ return stopping || batch != seen; });
+            if (stopping)
+                return;
+            seen = batch;
+        }
+
+        drain();
+
+        bool last = false;
+        {
+            std::lock_guard lock{ mutex };
+            last = --busy == 0;
+        }
+        if (last)
+            done.notify_one();
+    }
+}
+
+void WorkPool::drain() noexcept {
+    for (;;) {
+        const auto i = next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= count)
+            return;
+        try {
+            (*task)(i);
+        } catch (...) {
+            std::lock_guard lock{ mutex };
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+}
+
+
+}
@@ -0,0 +1,66 @@
+#ifndef WORKPOOL_H_INCLUDED
+#define WORKPOOL_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+
+/// A handful of threads that share out batches of small, independent tasks
+///
+/// `run' hands out the indices of a batch one at a time to whichever thread
+/// is free, the calling thread included, and returns once they're all done.
+/// The threads are kept between batches, so it's cheap enough to use for a
+/// batch of a few dozen tiny tasks (e.g. one phase of a battle).
+///
+/// Only one batch at a time: `run' mustn't be called from two threads at once.
+class WorkPool {
+public:
+    /// `threads' is how many threads to start, on top of the caller's own
+    explicit WorkPool(std::size_t threads);
+    ~WorkPool();
+
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    /// How many threads work on each batch, including the caller
+    [[nodiscard]] std::size_t size() const noexcept { return workers.size() + 1; }
+
+    /// Call `task(i)' for every `i' in [0, count), and wait for them all.
+    /// If any of them throw, the first exception is rethrown once the rest
+    /// of the batch has finished.
+    void run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;   ///< a new batch, or shutting down
+    std::condition_variable done;   ///< every worker is finished with the batch
+
+    // the current batch; only changed by `run' while no worker is busy
+    const std::function<void(std::size_t)>* task = nullptr;
+    std::size_t count = 0;
+    std::atomic<std::size_t> next{ 0 };
+    std::exception_ptr error;
+
+    std::size_t batch = 0;      ///< counts batches, so workers can tell a new one
+    std::size_t busy = 0;       ///< workers still on the current batch
+    bool stopping = false;
+
+    void work() noexcept;
+    void drain() noexcept;
+    void stop() noexcept;
+};
+
+
+}
+
+#endif // WORKPOOL_H_INCLUDED
@@ -0,0 +1,79 @@
+// Checks util::Histogram's statistics against values worked out by hand;
+// exits non-zero (and says what went wrong) if any are off.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "util/histogram.h"
+
+namespace {
+
+int failures = 0;
+
+void expect(const std::string& what, std::uint64_t got, std::uint64_t want) {
+    if (got != want) {
+        std::cerr << what << ": got " << got << ", expected " << want << "\n";
+        failures++;
+    }
+}
+
+}
+
+int main() {
+    {
+        util::Histogram h;
+        expect("empty p50", h.percentile(50), 0);
+    }
+    {
+        util::Histogram h;
+        for (std::uint64_t v : { 7u, 12u, 17u })
+            h.add(v);
+        expect("{7,12,17} p0", h.percentile(0), 7);
+        expect("{7,12,17} p33", h.percentile(33), 7);
+        expect("{7,12,17} p34", h.percentile(34), 12);
+        expect("{7,12,17} p50", h.percentile(50), 12);
+        expect("{7,12,17} p99", h.percentile(99), 17);
+        expect("{7,12,17} p100", h.percentile(100), 17);
+        expect("{7,12,17} min", h.min(), 7);
+        expect("{7,12,17} max", h.max(), 17);
+        expect("{7,12,17} sum", h.sum(), 36);
+    }
+    {
+        // small enough to be exact: the pth percentile of 1..100 is p
+        util::Histogram h;
+        for (std::uint64_t v = 1; v <= 100; v++)
+            h.add(v);
+        for (std::uint64_t p = 1; p <= 100; p++)
+            expect("1..100 p" + std::to_string(p), h.percentile(static_cast<double>(p)), p);
+    }
+    {
+        // merged halves give the same answers as the whole
+        util::Histogram low, high;
+        for (std::uint64_t v = 1; v <= 50; v++)
+            low.add(v);
+        for (std::uint64_t v = 51; v <= 100; v++)
+            high.add(v);
+        low.merge(high);
+        expect("merged count", low.count(), 100);
+        expect("merged p50", low.percentile(50), 50);
+        expect("merged p90", low.percentile(90), 90);
+    }
+    {
+        // large values come back within the histogram's precision
+        util::Histogram h;
+        h.add(1000000, 3);
+        h.add(5);
+        expect("large p25", h.percentile(25), 5);
+        expect("large p100", h.percentile(100), 1000000);
+        const auto p50 = h.percentile(50);
+        if (p50 < 1000000 - 1000000 / 64 || p50 > 1000000) {
+            std::cerr << "large p50: got " << p50 << ", expected about 1000000\n";
+            failures++;
+        }
+    }
+
+    if (failures == 0)
+        std::cout << "all histogram checks passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+// Plays lots of battles and checks that the lua state's memory stays put.
+// The collector only runs when the engine lets it (see battle/luamemory.h),
+// so if it isn't being given enough time, garbage piles up battle after
+// battle until the memory limit forces a full collection. Needs `./data'.
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "battle/battlesystem.h"
+#include "battle/entity.h"
+#include "battle/entityloader.h"
+#include "battle/luamemory.h"
+#include "battle/npccontroller.h"
+#include "battle/skill.h"
+#include "util/random.h"
+
+namespace {
+
+using EntityRef = std::shared_ptr<battle::Entity>;
+
+EntityRef makeEntity(const battle::EntityTemplate& t, const std::string& name) {
+    std::vector<battle::Skill> skills;
+    for (auto&& skill : t.skills)
+        skills.emplace_back(skill);
+
+    auto e = std::make_shared<battle::Entity>(
+        battle::EntityID{ t.kind, t.type, name }, 1, t.stats, std::move(skills));
+    e->assignController<battle::NPCController>();
+    return e;
+}
+
+// play `count' battles, only ever collecting between turns (as `doTurn'
+// does by itself), and give the most lua memory in use after any of them
+std::size_t play(long count, const battle::EntityTemplate& blue,
+                 const battle::EntityTemplate& red)
+{
+    std::size_t most = 0;
+    for (long i = 0; i < count; i++) {
+        battle::BattleSystem system{ { makeEntity(blue, "blue") },
+                                     { makeEntity(red, "red") } };
+        for (int turn = 0; turn < 10000 && !system.isDone(); turn++)
+            (void)system.doTurn();
+        most = std::max(most, battle::luaMemory().in_use);
+    }
+    return most;
+}
+
+}
+
+int main() {
+    try {
+        util::seed(1);
+        const auto blue = battle::loadEntityTemplate("default", "good");
+        const auto red = battle::loadEntityTemplate("default", "evil");
+
+        // the first battles fill the state up with what it keeps for good
+        (void)play(1000, blue, red);
+        const auto early = play(1000, blue, red);
+        (void)play(6000, blue, red);
+        const auto late = play(1000, blue, red);
+
+        std::cout << "lua memory in use: " << early / 1024 << "KiB early on, "
+                  << late / 1024 << "KiB " << 8000 << " battles later\n";
+        if (late > early + early / 2) {
+            std::cerr << "lua memory grew by more than half; is the collector "
+                         "getting its turn?\n";
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}